@@ -0,0 +1,290 @@
+/*
+ * Reconstructs U and V of the Gray-Scott simulation from delta encoded
+ * output (delta_keyframe > 0) and writes them in full, with the same axis
+ * order and precision, so the other tools can read them.
+ *
+ * Every process decodes a share of the blocks of the simulation, so the
+ * decoder runs on any number of processes.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mpi.h>
+
+#include "adios2.h"
+
+#include "../simulation/delta.h"
+
+void printUsage()
+{
+    std::cout
+        << "Usage: delta_decode input output [step]\n"
+        << "  input:  Delta encoded output of the simulation\n"
+        << "  output: Name of the output file with U and V in full\n"
+        << "  step:   Only write this simulation step, default all output "
+           "steps\n\n";
+}
+
+// Begin the next step of reader, false at the end of the stream
+bool next_step(adios2::Engine &reader)
+{
+    while (true) {
+        adios2::StepStatus status =
+            reader.BeginStep(adios2::StepMode::NextAvailable, 10.0f);
+        if (status == adios2::StepStatus::NotReady) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+            continue;
+        }
+        return status == adios2::StepStatus::OK;
+    }
+}
+
+// Copy a block of n = {nx, ny, nz} points from z fastest order to the order
+// of the output, x fastest unless native is set
+template <typename S, typename T>
+void from_native(const S *in, T *out, const size_t n[3], bool native)
+{
+    for (size_t x = 0; x < n[0]; x++) {
+        for (size_t y = 0; y < n[1]; y++) {
+            for (size_t z = 0; z < n[2]; z++) {
+                const size_t i = (x * n[1] + y) * n[2] + z;
+                out[native ? i : (z * n[1] + y) * n[0] + x] = in[i];
+            }
+        }
+    }
+}
+
+// The reverse of from_native
+template <typename T>
+void to_native(const T *in, T *out, const size_t n[3], bool native)
+{
+    for (size_t x = 0; x < n[0]; x++) {
+        for (size_t y = 0; y < n[1]; y++) {
+            for (size_t z = 0; z < n[2]; z++) {
+                const size_t i = (x * n[1] + y) * n[2] + z;
+                out[i] = in[native ? i : (z * n[1] + y) * n[0] + x];
+            }
+        }
+    }
+}
+
+// Selection of the block of n points from start, both {x, y, z}, in the
+// order of the output
+adios2::Box<adios2::Dims> selection(const size_t start[3], const size_t n[3],
+                                    bool native)
+{
+    if (native) {
+        return {{start[0], start[1], start[2]}, {n[0], n[1], n[2]}};
+    }
+    return {{start[2], start[1], start[0]}, {n[2], n[1], n[0]}};
+}
+
+void fail(const std::string &message)
+{
+    std::cerr << "delta_decode: " << message << std::endl;
+    MPI_Abort(MPI_COMM_WORLD, -1);
+}
+
+// Decode the stream of reader, whose first step has begun, with U and V of
+// type T
+template <typename T>
+void decode(adios2::Engine &reader, adios2::IO &reader_io,
+            adios2::IO &writer_io, const std::string &out_filename,
+            int only_step, MPI_Comm comm)
+{
+    int rank, procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &procs);
+
+    const std::string order =
+        reader_io.InquireAttribute<std::string>("axis_order").Data()[0];
+    const bool native = order == "xyz";
+    const double error =
+        reader_io.InquireAttribute<double>("delta_error").Data()[0];
+
+    // Blocks of the simulation, {x, y, z}
+    adios2::Variable<uint64_t> var_block_start =
+        reader_io.InquireVariable<uint64_t>("block_start");
+    adios2::Variable<uint64_t> var_block_count =
+        reader_io.InquireVariable<uint64_t>("block_count");
+    const size_t nblocks = var_block_start.Shape()[0];
+    std::vector<uint64_t> starts(3 * nblocks), counts(3 * nblocks);
+    reader.Get<uint64_t>(var_block_start, starts.data(), adios2::Mode::Sync);
+    reader.Get<uint64_t>(var_block_count, counts.data(), adios2::Mode::Sync);
+    size_t L = 0;
+    for (size_t b = 0; b < nblocks; b++) {
+        L = std::max<size_t>(L, starts[3 * b] + counts[3 * b]);
+    }
+
+    // Blocks decoded by this process
+    struct Block
+    {
+        size_t index;
+        size_t start[3], n[3];
+        DeltaCoder u, v;
+    };
+    std::vector<Block> blocks;
+    for (size_t b = rank; b < nblocks; b += procs) {
+        const uint64_t *s = &starts[3 * b], *n = &counts[3 * b];
+        blocks.push_back({b,
+                          {s[0], s[1], s[2]},
+                          {n[0], n[1], n[2]},
+                          DeltaCoder(error, n[0], n[1] * n[2]),
+                          DeltaCoder(error, n[0], n[1] * n[2])});
+    }
+
+    adios2::Variable<T> var_u_out =
+        writer_io.DefineVariable<T>("U", {L, L, L}, {0, 0, 0}, {1, 1, 1});
+    adios2::Variable<T> var_v_out =
+        writer_io.DefineVariable<T>("V", {L, L, L}, {0, 0, 0}, {1, 1, 1});
+    adios2::Variable<int> var_step_out = writer_io.DefineVariable<int>("step");
+    writer_io.DefineAttribute<std::string>("axis_order", order);
+    adios2::Engine writer =
+        writer_io.Open(out_filename, adios2::Mode::Write, comm);
+
+    std::vector<T> buf, block;
+    std::vector<uint8_t> bytes;
+    std::vector<uint64_t> u_bytes(nblocks), v_bytes(nblocks);
+    do {
+        int keyframe, step;
+        reader.Get<int>(reader_io.InquireVariable<int>("keyframe"), &keyframe,
+                        adios2::Mode::Sync);
+        reader.Get<int>(reader_io.InquireVariable<int>("step"), &step,
+                        adios2::Mode::Sync);
+
+        if (!keyframe) {
+            reader.Get<uint64_t>(
+                reader_io.InquireVariable<uint64_t>("U/delta_bytes"),
+                u_bytes.data(), adios2::Mode::Sync);
+            reader.Get<uint64_t>(
+                reader_io.InquireVariable<uint64_t>("V/delta_bytes"),
+                v_bytes.data(), adios2::Mode::Sync);
+        }
+
+        for (Block &b : blocks) {
+            DeltaCoder *coders[2] = {&b.u, &b.v};
+
+            if (keyframe) {
+                const size_t points = b.n[0] * b.n[1] * b.n[2];
+                const char *names[2] = {"U", "V"};
+                for (int f = 0; f < 2; f++) {
+                    adios2::Variable<T> var =
+                        reader_io.InquireVariable<T>(names[f]);
+                    var.SetSelection(selection(b.start, b.n, native));
+                    buf.resize(points);
+                    block.resize(points);
+                    reader.Get<T>(var, buf.data(), adios2::Mode::Sync);
+                    to_native(buf.data(), block.data(), b.n, native);
+                    coders[f]->key(block.data());
+                }
+                continue;
+            }
+
+            // The blocks are stored one after the other
+            const std::vector<uint64_t> *sizes[2] = {&u_bytes, &v_bytes};
+            const char *names[2] = {"U/delta", "V/delta"};
+            for (int f = 0; f < 2; f++) {
+                uint64_t offset = 0;
+                for (size_t c = 0; c < b.index; c++) {
+                    offset += (*sizes[f])[c];
+                }
+                const uint64_t count = (*sizes[f])[b.index];
+                bytes.resize(count);
+                if (count > 0) {
+                    adios2::Variable<uint8_t> var =
+                        reader_io.InquireVariable<uint8_t>(names[f]);
+                    var.SetSelection({{offset}, {count}});
+                    reader.Get<uint8_t>(var, bytes.data(), adios2::Mode::Sync);
+                }
+                if (!coders[f]->decode(bytes.data(), count)) {
+                    fail(std::string("corrupt ") + names[f] + " at step " +
+                         std::to_string(step));
+                }
+            }
+        }
+        reader.EndStep();
+
+        if (only_step >= 0 && step != only_step) {
+            continue;
+        }
+        if (!rank) {
+            std::cout << "Decoded step " << step
+                      << (keyframe ? " (keyframe)" : "") << std::endl;
+        }
+
+        writer.BeginStep();
+        if (!rank) {
+            writer.Put<int>(var_step_out, &step);
+        }
+        for (const Block &b : blocks) {
+            buf.resize(b.n[0] * b.n[1] * b.n[2]);
+            // Every block is put from the same buffer
+            var_u_out.SetSelection(selection(b.start, b.n, native));
+            from_native(b.u.values().data(), buf.data(), b.n, native);
+            writer.Put<T>(var_u_out, buf.data(), adios2::Mode::Sync);
+            var_v_out.SetSelection(selection(b.start, b.n, native));
+            from_native(b.v.values().data(), buf.data(), b.n, native);
+            writer.Put<T>(var_v_out, buf.data(), adios2::Mode::Sync);
+        }
+        writer.EndStep();
+    } while (next_step(reader));
+
+    writer.Close();
+}
+
+int main(int argc, char *argv[])
+{
+    MPI_Init(&argc, &argv);
+    int rank, wrank;
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &wrank);
+
+    const unsigned int color = 2;
+    MPI_Comm comm;
+    MPI_Comm_split(MPI_COMM_WORLD, color, wrank, &comm);
+    MPI_Comm_rank(comm, &rank);
+
+    if (argc < 3) {
+        std::cout << "Not enough arguments\n";
+        if (!rank) {
+            printUsage();
+        }
+        MPI_Finalize();
+        return 0;
+    }
+
+    const std::string in_filename = argv[1];
+    const std::string out_filename = argv[2];
+    const int only_step = argc >= 4 ? std::stoi(argv[3]) : -1;
+
+    adios2::ADIOS ad("adios2.xml", comm, adios2::DebugON);
+    adios2::IO reader_io = ad.DeclareIO("SimulationOutput");
+    adios2::IO writer_io = ad.DeclareIO("DeltaDecodeOutput");
+
+    adios2::Engine reader =
+        reader_io.Open(in_filename, adios2::Mode::Read, comm);
+
+    // The first step is a keyframe, U tells the precision
+    if (next_step(reader)) {
+        if (!reader_io.InquireVariable<int>("keyframe")) {
+            fail(in_filename + " is not delta encoded");
+        }
+        if (reader_io.VariableType("U") == "float") {
+            decode<float>(reader, reader_io, writer_io, out_filename,
+                          only_step, comm);
+        } else {
+            decode<double>(reader, reader_io, writer_io, out_filename,
+                           only_step, comm);
+        }
+    }
+
+    reader.Close();
+    MPI_Finalize();
+    return 0;
+}
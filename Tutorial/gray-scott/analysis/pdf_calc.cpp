@@ -171,6 +171,9 @@ int main(int argc, char *argv[])
     
     std::vector<double> u;
     std::vector<double> v;
+    // U and V as read when the simulation writes single precision
+    std::vector<float> u_float;
+    std::vector<float> v_float;
     int simStep;
 
     std::vector<double> pdf_u;
@@ -180,6 +183,7 @@ int main(int argc, char *argv[])
     
     // adios2 variable declarations
     adios2::Variable<double> var_u_in, var_v_in;
+    adios2::Variable<float> var_u_float_in, var_v_float_in;
     adios2::Variable<int> var_step_in;
     adios2::Variable<double> var_u_pdf, var_v_pdf;
     adios2::Variable<double> var_u_bins, var_v_bins;
@@ -227,17 +231,28 @@ int main(int argc, char *argv[])
         // This assumes that the variable dimensions do not change across timesteps
 
         // Inquire variable
-        var_u_in = reader_io.InquireVariable<double>("U");
-        var_v_in = reader_io.InquireVariable<double>("V");
+        // The simulation writes U and V in double or single precision, the
+        // analysis is done in double precision
+        const bool single = reader_io.VariableType("U") == "float";
+        std::pair<double, double> minmax_u, minmax_v;
+        if (single)
+        {
+            var_u_float_in = reader_io.InquireVariable<float>("U");
+            var_v_float_in = reader_io.InquireVariable<float>("V");
+            minmax_u = var_u_float_in.MinMax();
+            minmax_v = var_v_float_in.MinMax();
+            shape = var_u_float_in.Shape();
+        }
+        else
+        {
+            var_u_in = reader_io.InquireVariable<double>("U");
+            var_v_in = reader_io.InquireVariable<double>("V");
+            minmax_u = var_u_in.MinMax();
+            minmax_v = var_v_in.MinMax();
+            shape = var_u_in.Shape();
+        }
         var_step_in = reader_io.InquireVariable<int>("step");
 
-        
-
-        std::pair<double, double> minmax_u =  var_u_in.MinMax();
-        std::pair<double, double> minmax_v =  var_v_in.MinMax();
-
-        shape = var_u_in.Shape();
-
         // Calculate global and local sizes of U and V
         u_global_size = shape[0] * shape[1] * shape[2];
         u_local_size  = u_global_size/comm_size;
@@ -256,12 +271,19 @@ int main(int argc, char *argv[])
             << "}" << std::endl;*/
 
         // Set selection
-        var_u_in.SetSelection(adios2::Box<adios2::Dims>(
-                    {start1,0,0},
-                    {count1, shape[1], shape[2]}));
-        var_v_in.SetSelection(adios2::Box<adios2::Dims>(
+        const adios2::Box<adios2::Dims> selection(
                     {start1,0,0},
-                    {count1, shape[1], shape[2]}));
+                    {count1, shape[1], shape[2]});
+        if (single)
+        {
+            var_u_float_in.SetSelection(selection);
+            var_v_float_in.SetSelection(selection);
+        }
+        else
+        {
+            var_u_in.SetSelection(selection);
+            var_v_in.SetSelection(selection);
+        }
 
         // Declare variables to output
         if (firstStep) {
@@ -300,8 +322,16 @@ int main(int argc, char *argv[])
 
 
         // Read adios2 data
-        reader.Get<double>(var_u_in, u);
-        reader.Get<double>(var_v_in, v);
+        if (single)
+        {
+            reader.Get<float>(var_u_float_in, u_float);
+            reader.Get<float>(var_v_float_in, v_float);
+        }
+        else
+        {
+            reader.Get<double>(var_u_in, u);
+            reader.Get<double>(var_v_in, v);
+        }
         if (shouldIWrite)
         {
             reader.Get<int>(var_step_in, &simStep);
@@ -310,6 +340,12 @@ int main(int argc, char *argv[])
         // End adios2 step
         reader.EndStep();
 
+        if (single)
+        {
+            u.assign(u_float.begin(), u_float.end());
+            v.assign(v_float.begin(), v_float.end());
+        }
+
         if (!rank)
         {
             std::cout << "PDF Analysis step " << stepAnalysis
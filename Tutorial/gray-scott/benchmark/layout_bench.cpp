@@ -0,0 +1,137 @@
+// Compare the speed of the stencil sweep with u and v in separate arrays and
+// interleaved in blocks, on a single process. The ghost layer is kept fixed,
+// there is no halo exchange.
+//
+// Usage: layout_bench [L] [steps] [kernel]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../simulation/kernel.h"
+
+struct Layout
+{
+    const char *name;
+    // 0 for separate arrays, otherwise the interleave block
+    int block;
+    // Number of values in a z-row
+    int row;
+    Kernel<double>::calc_row_t calc_row;
+
+    Layout(const char *name, int block, int n,
+           Kernel<double>::calc_row_t calc_row)
+    : name(name), block(block), calc_row(calc_row)
+    {
+        row = block == 0 ? n : 2 * ((n + block - 1) / block * block);
+    }
+
+    int z2i(int z) const
+    {
+        return block == 0 ? z : z / block * 2 * block + z % block;
+    }
+};
+
+// Run steps sweeps over an L^3 grid with one ghost layer, return the seconds
+// per step and the final u
+double run(const Layout &layout, int L, int steps, std::vector<double> &result)
+{
+    const int n = L + 2;
+    const size_t level = static_cast<size_t>(n) * n * layout.row *
+                         (layout.block == 0 ? 2 : 1);
+    const size_t v_offset = layout.block == 0 ? level / 2 : layout.block;
+    std::vector<double> buf(2 * level);
+    double *u = buf.data(), *v = u + v_offset;
+    double *u2 = u + level, *v2 = u2 + v_offset;
+
+    const ptrdiff_t sy = layout.row;
+    const ptrdiff_t sx = static_cast<ptrdiff_t>(n) * layout.row;
+
+#pragma omp parallel for schedule(static)
+    for (int x = 0; x < n; x++) {
+        for (int y = 0; y < n; y++) {
+            for (int z = 0; z < n; z++) {
+                const size_t i = x * sx + y * sy + layout.z2i(z);
+                const bool seed =
+                    std::abs(x - n / 2) < 6 && std::abs(y - n / 2) < 6 &&
+                    std::abs(z - n / 2) < 6;
+                u[i] = u2[i] = seed ? 0.25 : 1.0;
+                v[i] = v2[i] = seed ? 0.33 : 0.0;
+            }
+        }
+    }
+
+    const KernelParams<double> p = {0.2,  0.1,  0.02,  0.02 + 0.048,
+                                    1.0,  0.01, {0, 0}};
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; step++) {
+#pragma omp parallel for collapse(2) schedule(static)
+        for (int x = 1; x < n - 1; x++) {
+            for (int y = 1; y < n - 1; y++) {
+                const NoiseCounter c = {static_cast<uint32_t>(x),
+                                        static_cast<uint32_t>(y), 1,
+                                        static_cast<uint32_t>(step)};
+                const size_t r = x * sx + y * sy;
+                layout.calc_row(&u[r], &v[r], &u2[r], &v2[r], 1, L, sx, sy, p,
+                                c);
+            }
+        }
+        std::swap(u, u2);
+        std::swap(v, v2);
+    }
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    result.clear();
+    for (int x = 1; x < n - 1; x++) {
+        for (int y = 1; y < n - 1; y++) {
+            for (int z = 1; z < n - 1; z++) {
+                result.push_back(u[x * sx + y * sy + layout.z2i(z)]);
+            }
+        }
+    }
+
+    return elapsed.count() / steps;
+}
+
+int main(int argc, char **argv)
+{
+    const int L = argc > 1 ? std::atoi(argv[1]) : 128;
+    const int steps = argc > 2 ? std::atoi(argv[2]) : 20;
+    const Kernel<double> kernel =
+        select_kernel<double>(argc > 3 ? argv[3] : "auto");
+
+    const Layout layouts[] = {
+        Layout("separate", 0, L + 2, kernel.calc_row),
+        Layout("interleaved", interleave_block<double>(), L + 2,
+               kernel.calc_row_interleaved),
+    };
+
+    std::cout << "grid:   " << L << "x" << L << "x" << L << std::endl;
+    std::cout << "steps:  " << steps << std::endl;
+    std::cout << "kernel: " << kernel.name << std::endl;
+    std::cout << "layout        ms/step     Mpoints/s" << std::endl;
+
+    std::vector<double> results[2];
+    for (int l = 0; l < 2; l++) {
+        const double t = run(layouts[l], L, steps, results[l]);
+        const double points = static_cast<double>(L) * L * L;
+        std::cout.width(12);
+        std::cout << std::left << layouts[l].name;
+        std::cout.width(12);
+        std::cout << std::right << t * 1e3;
+        std::cout.width(14);
+        std::cout << points / t * 1e-6 << std::endl;
+    }
+
+    if (results[0] != results[1]) {
+        std::cerr << "Layouts produced different results" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
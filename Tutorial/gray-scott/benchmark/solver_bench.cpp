@@ -0,0 +1,232 @@
+// Measure the phases of a simulation step over a range of local grid sizes:
+// the update of the interior (calc), the halo exchange and the removal of the
+// ghost layers for output (noghost). The update and the copy are compared to
+// the memory bandwidth measured with the STREAM triad on this node.
+// Results go to stdout and, as JSON, to a file that can be compared across
+// commits.
+//
+// Usage: mpirun -n N solver_bench [-s settings.json] [-o result.json]
+//                                 [n ...]
+//
+// n is the edge of the local block per process (default 16 32 64 128). The
+// settings file selects the solver options (kernel, precision, threads,
+// ghost_width, halo), L is set from n and the number of processes.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "../simulation/gray-scott.h"
+#include "../simulation/json.hpp"
+
+// Floating point operations of the update of one point without noise
+const double flops_per_point = 35.0;
+
+// Gives access to the phases of a step
+template <typename T>
+class BenchGrayScott : public GrayScott<T>
+{
+public:
+    using GrayScott<T>::GrayScott;
+
+    void calc() { GrayScott<T>::calc(this->u, this->v, this->u2, this->v2, 0); }
+    void exchange() { GrayScott<T>::exchange(this->u, this->v); }
+    uint64_t exchange_bytes() const { return GrayScott<T>::exchange_bytes; }
+};
+
+// Seconds per call of f, the slowest process counts. Runs f at least reps
+// times and for at least 0.2 s after one warm up call.
+template <typename F>
+double time_per_call(F f, int reps, MPI_Comm comm)
+{
+    f();
+    MPI_Barrier(comm);
+    int n = 0;
+    const double start = MPI_Wtime();
+    double elapsed = 0.0;
+    int done = 0;
+    while (!done) {
+        f();
+        n++;
+        elapsed = MPI_Wtime() - start;
+        // All processes must run the same number of calls
+        done = n >= reps && elapsed >= 0.2;
+        MPI_Allreduce(MPI_IN_PLACE, &done, 1, MPI_INT, MPI_LAND, comm);
+    }
+    double t = elapsed / n;
+    MPI_Allreduce(MPI_IN_PLACE, &t, 1, MPI_DOUBLE, MPI_MAX, comm);
+    return t;
+}
+
+// Bandwidth of the STREAM triad a = b + s * c of all processes together in
+// bytes per second, with arrays much larger than the caches
+double stream_triad(MPI_Comm comm)
+{
+    const size_t n = 1 << 23;
+    std::vector<double> a(n), b(n), c(n);
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; i++) {
+        a[i] = 0.0;
+        b[i] = 1.0;
+        c[i] = 2.0;
+    }
+
+    const double s = 3.0;
+    double best = 1e30;
+    for (int k = 0; k < 10; k++) {
+        MPI_Barrier(comm);
+        const double start = MPI_Wtime();
+#pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < n; i++) {
+            a[i] = b[i] + s * c[i];
+        }
+        double t = MPI_Wtime() - start;
+        MPI_Allreduce(MPI_IN_PLACE, &t, 1, MPI_DOUBLE, MPI_MAX, comm);
+        best = std::min(best, t);
+    }
+
+    int procs;
+    MPI_Comm_size(comm, &procs);
+    return 3.0 * sizeof(double) * n * procs / best;
+}
+
+template <typename T>
+nlohmann::json bench(const Settings &base, int n, double stream,
+                     MPI_Comm comm)
+{
+    int rank, procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &procs);
+
+    // Global L for about n^3 points per process
+    Settings settings = base;
+    settings.L = static_cast<int>(std::lround(n * std::cbrt(procs)));
+    settings.halo_overlap = false;
+
+    BenchGrayScott<T> sim(settings, comm);
+    sim.init();
+
+    const double points =
+        static_cast<double>(sim.size_x) * sim.size_y * sim.size_z;
+    std::vector<T> buf(sim.size_x * sim.size_y * sim.size_z);
+
+    const double t_calc = time_per_call([&] { sim.calc(); }, 10, comm);
+    const double t_exchange = time_per_call([&] { sim.exchange(); }, 10, comm);
+    const double t_noghost =
+        time_per_call([&] { sim.u_noghost(buf.data()); }, 10, comm);
+
+    // Minimum memory traffic: calc reads u and v and writes u2 and v2,
+    // noghost reads and writes one field
+    const double calc_bytes = 4 * sizeof(T) * points;
+    const double noghost_bytes = 2 * sizeof(T) * points;
+
+    nlohmann::json r;
+    r["n"] = n;
+    r["L"] = settings.L;
+    r["local"] = {sim.size_x, sim.size_y, sim.size_z};
+    r["calc"] = {{"seconds", t_calc},
+                 {"gflops", flops_per_point * points * procs / t_calc * 1e-9},
+                 {"gbytes_per_s", calc_bytes * procs / t_calc * 1e-9},
+                 {"stream_fraction", calc_bytes * procs / t_calc / stream}};
+    r["exchange"] = {
+        {"seconds", t_exchange},
+        {"bytes", sim.exchange_bytes()},
+        {"gbytes_per_s", sim.exchange_bytes() / t_exchange * 1e-9}};
+    r["noghost"] = {
+        {"seconds", t_noghost},
+        {"gbytes_per_s", noghost_bytes * procs / t_noghost * 1e-9},
+        {"stream_fraction", noghost_bytes * procs / t_noghost / stream}};
+
+    if (rank == 0) {
+        std::cout << std::setw(6) << n << std::setw(12)
+                  << std::to_string(sim.size_x) + "x" +
+                         std::to_string(sim.size_y) + "x" +
+                         std::to_string(sim.size_z)
+                  << std::fixed << std::setprecision(3) << std::setw(12)
+                  << t_calc * 1e3 << std::setw(10)
+                  << r["calc"]["gflops"].get<double>() << std::setw(10)
+                  << r["calc"]["gbytes_per_s"].get<double>() << std::setw(12)
+                  << t_exchange * 1e3 << std::setw(12) << t_noghost * 1e3
+                  << std::setw(10)
+                  << r["noghost"]["gbytes_per_s"].get<double>() << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+    }
+
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm comm = MPI_COMM_WORLD;
+    int rank, procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &procs);
+
+    Settings settings;
+    std::string output;
+    std::vector<int> sizes;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "-s" && i + 1 < argc) {
+            settings = Settings::from_json(argv[++i]);
+        } else if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            sizes.push_back(std::atoi(argv[i]));
+        }
+    }
+    if (sizes.empty()) {
+        sizes = {16, 32, 64, 128};
+    }
+
+    const double stream = stream_triad(comm);
+
+    if (rank == 0) {
+        std::cout << "processes:  " << procs << std::endl;
+        std::cout << "precision:  " << settings.precision << std::endl;
+        std::cout << "halo:       " << settings.halo << std::endl;
+        std::cout << "STREAM:     " << stream * 1e-9 << " GB/s" << std::endl;
+        std::cout << "     n       local   calc [ms]    GFLOP/s      GB/s"
+                     "  exch [ms]  copy [ms]  copy GB/s"
+                  << std::endl;
+    }
+
+    nlohmann::json results;
+    results["processes"] = procs;
+#ifdef _OPENMP
+    results["threads"] = omp_get_max_threads();
+#else
+    results["threads"] = 1;
+#endif
+    results["precision"] = settings.precision;
+    results["halo"] = settings.halo;
+    results["stream_gbytes_per_s"] = stream * 1e-9;
+    for (int n : sizes) {
+        if (settings.precision == "float") {
+            results["sizes"].push_back(bench<float>(settings, n, stream, comm));
+        } else {
+            results["sizes"].push_back(
+                bench<double>(settings, n, stream, comm));
+        }
+    }
+
+    if (rank == 0 && !output.empty()) {
+        std::ofstream ofs(output);
+        ofs << results.dump(2) << std::endl;
+    }
+
+    MPI_Finalize();
+}
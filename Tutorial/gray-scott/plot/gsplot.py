@@ -113,6 +113,9 @@ if __name__ == "__main__":
     plot_step = 0
     for fr_step in fr:
 #        if fr_step.current_step()
+        # Downsampled levels may be written less often than U and V
+        if args.varname not in fr.available_variables():
+            continue
         start, size, fullshape = mpi.Partition_3D_3D(fr, args)
         cur_step= fr_step.current_step()
         vars_info = fr.available_variables()
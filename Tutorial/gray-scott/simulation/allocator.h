@@ -0,0 +1,96 @@
+#ifndef __ALLOCATOR_H__
+#define __ALLOCATOR_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+#include <sys/mman.h>
+
+// Size of a transparent huge page on x86-64 and most ARM configurations
+const size_t huge_page_size = 2 * 1024 * 1024;
+
+// Ask the kernel to back the whole huge pages inside [p, p + bytes) with
+// huge pages. Only a hint, ignored where transparent huge pages are not
+// available.
+inline void advise_huge_pages(void *p, size_t bytes)
+{
+#ifdef MADV_HUGEPAGE
+    const uintptr_t begin =
+        (reinterpret_cast<uintptr_t>(p) + huge_page_size - 1) &
+        ~(huge_page_size - 1);
+    const uintptr_t end =
+        (reinterpret_cast<uintptr_t>(p) + bytes) & ~(huge_page_size - 1);
+    if (end > begin) {
+        madvise(reinterpret_cast<void *>(begin), end - begin, MADV_HUGEPAGE);
+    }
+#else
+    (void)p;
+    (void)bytes;
+#endif
+}
+
+// Allocator for the fields of the solver. Arrays of at least one huge page
+// are aligned to and padded to huge pages and advised to use them, smaller
+// ones are aligned to cache lines. Elements are default initialized, so
+// resizing a vector of numbers does not write its memory: the pages are
+// placed on a NUMA node by the thread that first writes them.
+template <typename T>
+class FieldAllocator
+{
+public:
+    typedef T value_type;
+
+    FieldAllocator() = default;
+    template <typename U>
+    FieldAllocator(const FieldAllocator<U> &)
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        size_t bytes = n * sizeof(T);
+        size_t alignment = 64;
+        if (bytes >= huge_page_size) {
+            alignment = huge_page_size;
+            bytes = (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+        }
+        void *p;
+        if (posix_memalign(&p, alignment, bytes) != 0) {
+            throw std::bad_alloc();
+        }
+        if (alignment == huge_page_size) {
+            advise_huge_pages(p, bytes);
+        }
+        return static_cast<T *>(p);
+    }
+
+    void deallocate(T *p, size_t) { free(p); }
+
+    template <typename U>
+    void construct(U *p)
+    {
+        ::new (static_cast<void *>(p)) U;
+    }
+    template <typename U, typename... Args>
+    void construct(U *p, Args &&... args)
+    {
+        ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const FieldAllocator<T> &, const FieldAllocator<U> &)
+{
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const FieldAllocator<T> &, const FieldAllocator<U> &)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "checkpoint.h"
+
+template <typename T>
+Checkpoint<T>::Checkpoint(const Settings &settings, adios2::IO io,
+                          MPI_Comm comm)
+    : settings(settings), io(io), comm(comm), next(0), last_time(0.0),
+      last_steps(0)
+{
+    MPI_Comm_rank(comm, &rank);
+}
+
+template <typename T>
+int Checkpoint<T>::restore(const std::string &fname, GrayScott<T> &sim)
+{
+    adios2::Engine reader = io.Open(fname, adios2::Mode::Read);
+
+    const std::string type = sizeof(T) == sizeof(float) ? "float" : "double";
+    if (io.VariableType("U") != type || io.VariableType("V") != type) {
+        if (rank == 0) {
+            std::cerr << fname << " has no U and V of precision " << type
+                      << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+
+    adios2::Variable<T> var_u_in = io.InquireVariable<T>("U");
+    adios2::Variable<T> var_v_in = io.InquireVariable<T>("V");
+    adios2::Variable<int> var_step_in = io.InquireVariable<int>("step");
+    adios2::Variable<uint64_t> var_seed_in =
+        io.InquireVariable<uint64_t>("seed");
+
+    const size_t L = settings.L;
+    if (var_u_in.Shape() != adios2::Dims{L, L, L}) {
+        if (rank == 0) {
+            std::cerr << fname << " was written with a different L"
+                      << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+
+    // Read the last checkpoint, each process reads its own block
+    const size_t last = var_u_in.Steps() - 1;
+    var_u_in.SetStepSelection({last, 1});
+    var_v_in.SetStepSelection({last, 1});
+    var_step_in.SetStepSelection({last, 1});
+    var_seed_in.SetStepSelection({last, 1});
+
+    const adios2::Box<adios2::Dims> selection(
+        {sim.offset_x, sim.offset_y, sim.offset_z},
+        {sim.size_x, sim.size_y, sim.size_z});
+    var_u_in.SetSelection(selection);
+    var_v_in.SetSelection(selection);
+
+    std::vector<T> u_in(sim.size_x * sim.size_y * sim.size_z);
+    std::vector<T> v_in(sim.size_x * sim.size_y * sim.size_z);
+    int steps;
+    uint64_t seed;
+    reader.Get<T>(var_u_in, u_in.data());
+    reader.Get<T>(var_v_in, v_in.data());
+    reader.Get<int>(var_step_in, &steps);
+    reader.Get<uint64_t>(var_seed_in, &seed);
+    reader.PerformGets();
+    reader.Close();
+
+    // The noise of the following steps depends on the seed
+    if (seed != settings.seed) {
+        if (rank == 0) {
+            std::cerr << fname << " was written with seed " << seed
+                      << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+
+    sim.restore(steps, u_in.data(), v_in.data());
+
+    // The variables are defined again for writing
+    io.RemoveAllVariables();
+
+    return steps;
+}
+
+template <typename T>
+void Checkpoint<T>::define(const GrayScott<T> &sim)
+{
+    const size_t L = settings.L;
+    var_u = io.DefineVariable<T>(
+        "U", {L, L, L}, {sim.offset_x, sim.offset_y, sim.offset_z},
+        {sim.size_x, sim.size_y, sim.size_z});
+    var_v = io.DefineVariable<T>(
+        "V", {L, L, L}, {sim.offset_x, sim.offset_y, sim.offset_z},
+        {sim.size_x, sim.size_y, sim.size_z});
+    var_step = io.DefineVariable<int>("step");
+    var_seed = io.DefineVariable<uint64_t>("seed");
+}
+
+template <typename T>
+void Checkpoint<T>::open(const std::string &fname, const GrayScott<T> &sim,
+                         int steps)
+{
+    define(sim);
+    writer = io.Open(fname, adios2::Mode::Write);
+
+    // Without a measured cost the first interval is the output interval
+    if (settings.checkpoint_freq > 0) {
+        const int freq = settings.checkpoint_freq;
+        next = (steps / freq + 1) * freq;
+    } else {
+        next = steps + settings.plotgap;
+    }
+    last_time = MPI_Wtime();
+    last_steps = steps;
+}
+
+template <typename T>
+bool Checkpoint<T>::due(int steps) const
+{
+    return steps == next;
+}
+
+template <typename T>
+void Checkpoint<T>::write(int steps, const GrayScott<T> &sim)
+{
+    const double start = MPI_Wtime();
+
+    // One buffer for both fields, Sync copies it into the engine
+    std::vector<T> buf(sim.size_x * sim.size_y * sim.size_z);
+    writer.BeginStep();
+    writer.Put<int>(var_step, &steps);
+    writer.Put<uint64_t>(var_seed, &settings.seed);
+    sim.u_noghost(buf.data(), true);
+    writer.Put<T>(var_u, buf.data(), adios2::Mode::Sync);
+    sim.v_noghost(buf.data(), true);
+    writer.Put<T>(var_v, buf.data(), adios2::Mode::Sync);
+    writer.EndStep();
+
+    const double end = MPI_Wtime();
+
+    if (settings.checkpoint_freq > 0) {
+        next = steps + settings.checkpoint_freq;
+    } else {
+        // Space the checkpoints so that writing them takes the given
+        // fraction of the run time. All processes must agree on the
+        // interval, so use the slowest one.
+        double t[2] = {end - start, 0.0};
+        if (steps > last_steps) {
+            t[1] = (start - last_time) / (steps - last_steps);
+        }
+        MPI_Allreduce(MPI_IN_PLACE, t, 2, MPI_DOUBLE, MPI_MAX, comm);
+        int interval = settings.plotgap;
+        if (t[1] > 0.0) {
+            interval = static_cast<int>(
+                std::ceil(t[0] / (settings.checkpoint_overhead * t[1])));
+        }
+        next = steps + std::max(interval, 1);
+        last_time = end;
+        last_steps = steps;
+    }
+}
+
+template <typename T>
+void Checkpoint<T>::close()
+{
+    writer.Close();
+}
+
+template class Checkpoint<double>;
+template class Checkpoint<float>;
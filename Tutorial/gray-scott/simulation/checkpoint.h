@@ -0,0 +1,53 @@
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include <string>
+
+#include <adios2.h>
+#include <mpi.h>
+
+#include "gray-scott.h"
+#include "settings.h"
+
+// Writes the state of the simulation to a checkpoint stream and restores it.
+// U and V are global {x, y, z} arrays, so a run can be restarted on any
+// number of processes.
+template <typename T>
+class Checkpoint
+{
+public:
+    Checkpoint(const Settings &settings, adios2::IO io, MPI_Comm comm);
+    // Restore sim from the last checkpoint in fname and return the number of
+    // steps it had taken. Must be called before open.
+    int restore(const std::string &fname, GrayScott<T> &sim);
+    // Open the checkpoint stream of sim, which has taken the given number of
+    // steps
+    void open(const std::string &fname, const GrayScott<T> &sim, int steps);
+    // True if a checkpoint is due after the given number of steps
+    bool due(int steps) const;
+    void write(int steps, const GrayScott<T> &sim);
+    void close();
+
+protected:
+    Settings settings;
+    adios2::IO io;
+    MPI_Comm comm;
+    int rank;
+    adios2::Engine writer;
+    adios2::Variable<T> var_u;
+    adios2::Variable<T> var_v;
+    adios2::Variable<int> var_step;
+    adios2::Variable<uint64_t> var_seed;
+
+    // Step of the next checkpoint
+    int next;
+    // Time and step at the end of the last checkpoint, used to choose the
+    // interval automatically
+    double last_time;
+    int last_steps;
+
+    // Define the variables for writing with the decomposition of sim
+    void define(const GrayScott<T> &sim);
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include <cmath>
+
+#include "delta.h"
+
+namespace
+{
+
+void put_varint(uint64_t v, std::vector<uint8_t> &out)
+{
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+// Read a varint at in[p], false if it runs past the end
+bool get_varint(const uint8_t *in, size_t bytes, size_t &p, uint64_t &v)
+{
+    v = 0;
+    for (int shift = 0; p < bytes && shift < 64; shift += 7) {
+        const uint8_t b = in[p++];
+        v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (b < 0x80) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// A run of n unchanged values
+void put_run(uint64_t n, std::vector<uint8_t> &out)
+{
+    if (n > 0) {
+        out.push_back(0);
+        put_varint(n - 1, out);
+    }
+}
+
+} // end anonymous namespace
+
+DeltaCoder::DeltaCoder(double error, size_t planes, size_t plane_size)
+    : step(2 * error), planes(planes), plane_size(plane_size),
+      r(planes * plane_size), plane_bytes(planes)
+{
+}
+
+template <typename T>
+void DeltaCoder::key(const T *x)
+{
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < r.size(); i++) {
+        r[i] = x[i];
+    }
+}
+
+template <typename T>
+void DeltaCoder::encode(const T *x, std::vector<uint8_t> &out)
+{
+#pragma omp parallel for schedule(static)
+    for (size_t p = 0; p < planes; p++) {
+        std::vector<uint8_t> &b = plane_bytes[p];
+        b.clear();
+        uint64_t run = 0;
+        for (size_t i = p * plane_size; i < (p + 1) * plane_size; i++) {
+            const int64_t q = std::llround((x[i] - r[i]) / step);
+            if (q == 0) {
+                run++;
+                continue;
+            }
+            put_run(run, b);
+            run = 0;
+            r[i] += q * step;
+            // Zigzag maps small changes of either sign to small numbers
+            put_varint(static_cast<uint64_t>(q) << 1 ^
+                           static_cast<uint64_t>(q >> 63),
+                       b);
+        }
+        put_run(run, b);
+    }
+
+    for (const std::vector<uint8_t> &b : plane_bytes) {
+        out.insert(out.end(), b.begin(), b.end());
+    }
+}
+
+bool DeltaCoder::decode(const uint8_t *in, size_t bytes)
+{
+    size_t p = 0, i = 0;
+    const size_t n = r.size();
+    while (p < bytes) {
+        uint64_t z;
+        if (!get_varint(in, bytes, p, z)) {
+            return false;
+        }
+        if (z == 0) {
+            uint64_t run;
+            if (!get_varint(in, bytes, p, run) || run >= n - i) {
+                return false;
+            }
+            i += run + 1;
+            continue;
+        }
+        if (i == n) {
+            return false;
+        }
+        const int64_t q = static_cast<int64_t>(z >> 1 ^ (0 - (z & 1)));
+        r[i++] += q * step;
+    }
+    return i == n;
+}
+
+template void DeltaCoder::key<double>(const double *x);
+template void DeltaCoder::key<float>(const float *x);
+template void DeltaCoder::encode<double>(const double *x,
+                                         std::vector<uint8_t> &out);
+template void DeltaCoder::encode<float>(const float *x,
+                                        std::vector<uint8_t> &out);
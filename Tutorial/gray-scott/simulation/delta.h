@@ -0,0 +1,40 @@
+#ifndef __DELTA_H__
+#define __DELTA_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Error-bounded encoding of the change of a block of values between output
+// steps. Writer and reader keep the same reconstruction of the block. The
+// change of every value from its reconstruction is quantized to a multiple
+// of 2 * error, so each reconstructed value stays within error of the value
+// written, however many changes follow a key. Quantized changes are stored as
+// zigzag varints, and a run of n unchanged values as 0 followed by n - 1.
+class DeltaCoder
+{
+public:
+    // Block of planes * plane_size values, each plane is encoded on its own
+    DeltaCoder(double error, size_t planes, size_t plane_size);
+    // Start over from the values x
+    template <typename T>
+    void key(const T *x);
+    // Append the encoded change from the reconstruction to x to out and
+    // update the reconstruction
+    template <typename T>
+    void encode(const T *x, std::vector<uint8_t> &out);
+    // Apply an encoded change to the reconstruction. Returns false if the
+    // encoding does not hold one change per value.
+    bool decode(const uint8_t *in, size_t bytes);
+    // The reconstruction of the block
+    const std::vector<double> &values() const { return r; }
+
+protected:
+    double step;
+    size_t planes, plane_size;
+    std::vector<double> r;
+    // Encoding of every plane before they are joined
+    std::vector<std::vector<uint8_t>> plane_bytes;
+};
+
+#endif
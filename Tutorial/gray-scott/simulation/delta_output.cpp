@@ -0,0 +1,87 @@
+#include "delta_output.h"
+
+template <typename T>
+DeltaOutput<T>::DeltaOutput(const Settings &settings, const GrayScott<T> &sim,
+                            adios2::IO io, MPI_Comm comm)
+    : settings(settings), comm(comm),
+      u_coder(settings.delta_error, sim.size_x, sim.size_y * sim.size_z),
+      v_coder(settings.delta_error, sim.size_x, sim.size_y * sim.size_z),
+      field(sim.size_x * sim.size_y * sim.size_z)
+{
+    int procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &procs);
+
+    io.DefineAttribute<int>("delta_keyframe", settings.delta_keyframe);
+    io.DefineAttribute<double>("delta_error", settings.delta_error);
+
+    const size_t np = procs, r = rank;
+    var_keyframe = io.DefineVariable<int>("keyframe");
+    var_block_start =
+        io.DefineVariable<uint64_t>("block_start", {np, 3}, {r, 0}, {1, 3});
+    var_block_count =
+        io.DefineVariable<uint64_t>("block_count", {np, 3}, {r, 0}, {1, 3});
+    // The size of the encoding changes every step, the shape and selection
+    // are set before every Put
+    var_u_delta = io.DefineVariable<uint8_t>("U/delta", {1}, {0}, {1});
+    var_v_delta = io.DefineVariable<uint8_t>("V/delta", {1}, {0}, {1});
+    var_u_bytes = io.DefineVariable<uint64_t>("U/delta_bytes", {np}, {r}, {1});
+    var_v_bytes = io.DefineVariable<uint64_t>("V/delta_bytes", {np}, {r}, {1});
+
+    block_start[0] = sim.offset_x;
+    block_start[1] = sim.offset_y;
+    block_start[2] = sim.offset_z;
+    block_count[0] = sim.size_x;
+    block_count[1] = sim.size_y;
+    block_count[2] = sim.size_z;
+}
+
+template <typename T>
+void DeltaOutput<T>::put(adios2::Engine &writer, const GrayScott<T> &sim,
+                         bool keyframe)
+{
+    is_keyframe = keyframe;
+    writer.Put<int>(var_keyframe, &is_keyframe);
+    writer.Put<uint64_t>(var_block_start, block_start);
+    writer.Put<uint64_t>(var_block_count, block_count);
+
+    if (keyframe) {
+        sim.u_noghost(field.data(), true);
+        u_coder.key(field.data());
+        sim.v_noghost(field.data(), true);
+        v_coder.key(field.data());
+        return;
+    }
+
+    u_delta.clear();
+    v_delta.clear();
+    sim.u_noghost(field.data(), true);
+    u_coder.encode(field.data(), u_delta);
+    sim.v_noghost(field.data(), true);
+    v_coder.encode(field.data(), v_delta);
+
+    delta_bytes[0] = u_delta.size();
+    delta_bytes[1] = v_delta.size();
+    uint64_t offsets[2] = {0, 0}, totals[2];
+    MPI_Exscan(delta_bytes, offsets, 2, MPI_UINT64_T, MPI_SUM, comm);
+    if (rank == 0) {
+        offsets[0] = offsets[1] = 0;
+    }
+    MPI_Allreduce(delta_bytes, totals, 2, MPI_UINT64_T, MPI_SUM, comm);
+
+    writer.Put<uint64_t>(var_u_bytes, &delta_bytes[0]);
+    writer.Put<uint64_t>(var_v_bytes, &delta_bytes[1]);
+    var_u_delta.SetShape({totals[0]});
+    var_u_delta.SetSelection({{offsets[0]}, {delta_bytes[0]}});
+    var_v_delta.SetShape({totals[1]});
+    var_v_delta.SetSelection({{offsets[1]}, {delta_bytes[1]}});
+    if (delta_bytes[0] > 0) {
+        writer.Put<uint8_t>(var_u_delta, u_delta.data());
+    }
+    if (delta_bytes[1] > 0) {
+        writer.Put<uint8_t>(var_v_delta, v_delta.data());
+    }
+}
+
+template class DeltaOutput<double>;
+template class DeltaOutput<float>;
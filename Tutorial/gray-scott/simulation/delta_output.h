@@ -0,0 +1,54 @@
+#ifndef __DELTA_OUTPUT_H__
+#define __DELTA_OUTPUT_H__
+
+#include <cstdint>
+#include <vector>
+
+#include <adios2.h>
+#include <mpi.h>
+
+#include "delta.h"
+#include "gray-scott.h"
+#include "settings.h"
+
+// Delta encoded output of U and V. Every delta_keyframe-th output step is a
+// keyframe with U and V in full, the steps in between hold the change of
+// every block since the previous output step, see DeltaCoder. The blocks of
+// all processes are joined into the global byte arrays U/delta and V/delta,
+// block p takes U/delta_bytes[p] bytes after the blocks before it and covers
+// block_count[p] points from block_start[p], {x, y, z} with z fastest.
+template <typename T>
+class DeltaOutput
+{
+public:
+    DeltaOutput(const Settings &settings, const GrayScott<T> &sim,
+                adios2::IO io, MPI_Comm comm);
+    // True if output step n is a keyframe
+    bool keyframe(int n) const { return n % settings.delta_keyframe == 0; }
+    // Put the block layout and the keyframe flag of an output step. For a
+    // keyframe the reconstruction starts over from sim, otherwise the change
+    // of U and V since the last output step is put. Must be called by all
+    // processes, the data stays until EndStep.
+    void put(adios2::Engine &writer, const GrayScott<T> &sim, bool keyframe);
+
+protected:
+    Settings settings;
+    MPI_Comm comm;
+    int rank;
+    adios2::Variable<int> var_keyframe;
+    adios2::Variable<uint64_t> var_block_start, var_block_count;
+    adios2::Variable<uint8_t> var_u_delta, var_v_delta;
+    adios2::Variable<uint64_t> var_u_bytes, var_v_bytes;
+
+    DeltaCoder u_coder, v_coder;
+    // U or V without ghosts, z fastest
+    std::vector<T> field;
+
+    // Kept until EndStep
+    int is_keyframe;
+    uint64_t block_start[3], block_count[3];
+    std::vector<uint8_t> u_delta, v_delta;
+    uint64_t delta_bytes[2];
+};
+
+#endif
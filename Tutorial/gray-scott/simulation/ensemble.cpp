@@ -0,0 +1,104 @@
+#include "ensemble.h"
+
+template <typename T>
+EnsembleWriter<T>::EnsembleWriter(const Settings &settings,
+                                  const std::vector<GrayScott<T> *> &sims,
+                                  const std::vector<int> &members,
+                                  adios2::IO io)
+    : settings(settings), sims(sims), members(members), io(io)
+{
+    std::vector<double> F, k, Du, Dv;
+    for (const EnsembleMember &m : settings.ensemble) {
+        F.push_back(m.F);
+        k.push_back(m.k);
+        Du.push_back(m.Du);
+        Dv.push_back(m.Dv);
+    }
+    const size_t M = settings.ensemble.size();
+    io.DefineAttribute<double>("F", F.data(), M);
+    io.DefineAttribute<double>("k", k.data(), M);
+    io.DefineAttribute<double>("dt", settings.dt);
+    io.DefineAttribute<double>("Du", Du.data(), M);
+    io.DefineAttribute<double>("Dv", Dv.data(), M);
+    io.DefineAttribute<double>("noise", settings.noise);
+    io.DefineAttribute<uint64_t>("seed", settings.seed);
+
+    io.DefineAttribute<std::string>("axis_order", "m" + settings.output_order);
+
+    native = settings.output_order == "xyz";
+
+    // The selection is set for every member before it is written
+    const size_t L = settings.L;
+    var_u = io.DefineVariable<T>("U", {M, L, L, L}, {0, 0, 0, 0},
+                                 {1, L, L, L});
+    var_v = io.DefineVariable<T>("V", {M, L, L, L}, {0, 0, 0, 0},
+                                 {1, L, L, L});
+    var_step = io.DefineVariable<int>("step");
+
+    u.resize(sims.size());
+    v.resize(sims.size());
+    for (size_t i = 0; i < sims.size(); i++) {
+        u[i].resize(sims[i]->size_x * sims[i]->size_y * sims[i]->size_z);
+        v[i].resize(sims[i]->size_x * sims[i]->size_y * sims[i]->size_z);
+    }
+}
+
+template <typename T>
+void EnsembleWriter<T>::open(const std::string &fname)
+{
+    writer = io.Open(fname, adios2::Mode::Write);
+}
+
+template <typename T>
+void EnsembleWriter<T>::select(size_t i)
+{
+    const GrayScott<T> &sim = *sims[i];
+    const size_t m = members[i];
+    adios2::Box<adios2::Dims> box;
+    if (native) {
+        box = {{m, sim.offset_x, sim.offset_y, sim.offset_z},
+               {1, sim.size_x, sim.size_y, sim.size_z}};
+    } else {
+        box = {{m, sim.offset_z, sim.offset_y, sim.offset_x},
+               {1, sim.size_z, sim.size_y, sim.size_x}};
+    }
+    var_u.SetSelection(box);
+    var_v.SetSelection(box);
+}
+
+template <typename T>
+void EnsembleWriter<T>::write(int step)
+{
+    const uint64_t field_bytes =
+        2 * sizeof(T) * u.size() * (u.empty() ? 0 : u[0].size());
+    {
+        PhaseTimer timer(perf, PHASE_NOGHOST, field_bytes);
+        for (size_t i = 0; i < sims.size(); i++) {
+            sims[i]->u_noghost(u[i].data(), native);
+            sims[i]->v_noghost(v[i].data(), native);
+        }
+    }
+
+    writer.BeginStep();
+    {
+        PhaseTimer timer(perf, PHASE_PUT, field_bytes);
+        writer.Put<int>(var_step, &step);
+        // Deferred Puts keep the selection they were made with
+        for (size_t i = 0; i < sims.size(); i++) {
+            select(i);
+            writer.Put<T>(var_u, u[i].data());
+            writer.Put<T>(var_v, v[i].data());
+        }
+    }
+    PhaseTimer timer(perf, PHASE_ENDSTEP);
+    writer.EndStep();
+}
+
+template <typename T>
+void EnsembleWriter<T>::close()
+{
+    writer.Close();
+}
+
+template class EnsembleWriter<double>;
+template class EnsembleWriter<float>;
@@ -0,0 +1,53 @@
+#ifndef __ENSEMBLE_H__
+#define __ENSEMBLE_H__
+
+#include <string>
+#include <vector>
+
+#include <adios2.h>
+#include <mpi.h>
+
+#include "gray-scott.h"
+#include "perf.h"
+#include "settings.h"
+
+// Writes U, V and the step number of all members of an ensemble to one
+// ADIOS2 stream. U and V get the member as their first dimension, and the
+// parameters of the members are attributes.
+template <typename T>
+class EnsembleWriter
+{
+public:
+    // sims[i] is member members[i] of the ensemble
+    EnsembleWriter(const Settings &settings,
+                   const std::vector<GrayScott<T> *> &sims,
+                   const std::vector<int> &members, adios2::IO io);
+    void open(const std::string &fname);
+    // Write all members after the given step. Must be called by all
+    // processes of the stream.
+    void write(int step);
+    void close();
+
+    // Receives the time of the copies, Put and EndStep if set
+    Perf *perf = nullptr;
+
+protected:
+    Settings settings;
+    std::vector<GrayScott<T> *> sims;
+    std::vector<int> members;
+    adios2::IO io;
+    adios2::Engine writer;
+    adios2::Variable<T> var_u;
+    adios2::Variable<T> var_v;
+    adios2::Variable<int> var_step;
+
+    // Write U and V with z fastest
+    bool native;
+    // Copies of U and V of each member, kept until EndStep
+    std::vector<std::vector<T>> u, v;
+
+    // Select the block of member i of this process
+    void select(size_t i);
+};
+
+#endif
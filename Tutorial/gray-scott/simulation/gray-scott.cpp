@@ -2,63 +2,623 @@
 // code available at:
 // https://github.com/kaityo256/sevendayshpc/tree/master/day5
 
+#include <algorithm>
+#include <iostream>
 #include <mpi.h>
-#include <random>
 #include <vector>
 
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "gray-scott.h"
 
-GrayScott::GrayScott(const Settings &settings, MPI_Comm comm)
-    : settings(settings), comm(comm), rand_dev(), mt_gen(rand_dev()),
-      uniform_dist(-1.0, 1.0)
+namespace
+{
+
+template <typename T>
+MPI_Datatype mpi_type();
+
+template <>
+MPI_Datatype mpi_type<double>()
+{
+    return MPI_DOUBLE;
+}
+
+template <>
+MPI_Datatype mpi_type<float>()
+{
+    return MPI_FLOAT;
+}
+
+// Number of points and global coordinate of the first point of block p, when
+// L points are split into n blocks. The first L % n blocks get one more point.
+void split_axis(int L, int n, int p, size_t &size, size_t &offset)
 {
+    const int base = L / n, rest = L % n;
+    size = base + (p < rest ? 1 : 0);
+    offset = p * base + std::min(p, rest);
 }
 
-GrayScott::~GrayScott() {}
+// Choose the process grid for an L^3 domain that minimizes the halo surface
+// of the largest block, with at least min_points points per process along
+// every axis. Among equal grids the one with the most processes in x comes
+// first, like MPI_Dims_create. False if no grid has blocks that large.
+bool choose_dims(int procs, int L, int min_points, int dims[3])
+{
+    long best = -1;
+    for (int a = procs; a >= 1; a--) {
+        if (procs % a != 0) continue;
+        for (int b = procs / a; b >= 1; b--) {
+            if (procs / a % b != 0) continue;
+            const int c = procs / a / b;
+            // The blocks of the last processes along an axis are the smallest
+            if (L / a < min_points || L / b < min_points ||
+                L / c < min_points) {
+                continue;
+            }
+
+            const long nx = (L + a - 1) / a;
+            const long ny = (L + b - 1) / b;
+            const long nz = (L + c - 1) / c;
+            const long surface = ny * nz + nx * nz + nx * ny;
+            if (best < 0 || surface < best) {
+                best = surface;
+                dims[0] = a;
+                dims[1] = b;
+                dims[2] = c;
+            }
+        }
+    }
+    return best >= 0;
+}
 
-void GrayScott::init()
+// Index of the node of every process of comm, with nodes numbered in the
+// order of their lowest rank, and the rank of this process on its node.
+// False if the nodes do not all have the same number of processes.
+bool find_nodes(MPI_Comm comm, std::vector<int> &node_of, int &node_rank,
+                int &node_size)
 {
+    int rank, procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &procs);
+
+    MPI_Comm node_comm;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL,
+                        &node_comm);
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm_size(node_comm, &node_size);
+    // The first process of a node names it
+    int leader = rank;
+    MPI_Bcast(&leader, 1, MPI_INT, 0, node_comm);
+    MPI_Comm_free(&node_comm);
+
+    std::vector<int> leaders(procs);
+    MPI_Allgather(&leader, 1, MPI_INT, leaders.data(), 1, MPI_INT, comm);
+
+    // Leaders are their own leader, so counting them in rank order numbers
+    // the nodes
+    std::vector<int> index(procs, -1);
+    std::vector<int> sizes;
+    node_of.resize(procs);
+    for (int r = 0; r < procs; r++) {
+        if (leaders[r] == r) {
+            index[r] = sizes.size();
+            sizes.push_back(0);
+        }
+        node_of[r] = index[leaders[r]];
+        sizes[node_of[r]]++;
+    }
+    for (int n : sizes) {
+        if (n != node_size) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Choose the box of tile[0] x tile[1] x tile[2] processes that every node
+// gets in the process grid dims, with node_size processes per node, so that
+// the fewest halo points cross nodes. False if no box fits.
+bool choose_node_tile(const int dims[3], int L, int node_size, int tile[3])
+{
+    const int procs = dims[0] * dims[1] * dims[2];
+    long best = -1;
+    for (int a = 1; a <= dims[0]; a++) {
+        if (dims[0] % a != 0 || node_size % a != 0) continue;
+        for (int b = 1; b <= dims[1]; b++) {
+            if (dims[1] % b != 0 || node_size / a % b != 0) continue;
+            const int c = node_size / a / b;
+            if (dims[2] % c != 0) continue;
+
+            // Every line of processes along an axis crosses a node boundary
+            // once per node it passes through, unless one node holds it
+            const int t[3] = {a, b, c};
+            long crossing = 0;
+            for (int d = 0; d < 3; d++) {
+                const int nodes = dims[d] / t[d];
+                if (nodes == 1) continue;
+                const long face = static_cast<long>(L / dims[(d + 1) % 3]) *
+                                  (L / dims[(d + 2) % 3]);
+                crossing += static_cast<long>(nodes) * (procs / dims[d]) * face;
+            }
+            if (best < 0 || crossing < best) {
+                best = crossing;
+                tile[0] = a;
+                tile[1] = b;
+                tile[2] = c;
+            }
+        }
+    }
+    return best >= 0;
+}
+
+} // end anonymous namespace
+
+template <typename T>
+GrayScott<T>::GrayScott(const Settings &settings, MPI_Comm comm)
+    : kernel(select_kernel<T>(settings.kernel)), settings(settings),
+      comm(comm)
+{
+}
+
+template <typename T>
+GrayScott<T>::~GrayScott()
+{
+    int finalized;
+    MPI_Finalized(&finalized);
+    if (!finalized && field_win != MPI_WIN_NULL) {
+        MPI_Win_unlock_all(field_win);
+        MPI_Win_free(&field_win);
+        MPI_Comm_free(&node_comm);
+    }
+}
+
+template <typename T>
+void GrayScott<T>::init()
+{
+#ifdef _OPENMP
+    if (settings.threads > 0) {
+        omp_set_num_threads(settings.threads);
+    }
+    nthreads = omp_get_max_threads();
+#else
+    nthreads = 1;
+#endif
+
     init_mpi();
+    init_storage();
+    init_tiles();
     init_field();
+    if (settings.halo != "datatype") {
+        init_halo_faces();
+    }
+    init_exchange_bytes();
 }
 
-void GrayScott::iterate()
+template <typename T>
+void GrayScott<T>::iterate()
 {
-    exchange(u, v);
-    calc(u, v, u2, v2);
+    // The update reads u and v and writes u2 and v2 at least once
+    const uint64_t calc_bytes = 4 * sizeof(T) * size_x * size_y * size_z;
+
+    if (settings.halo_overlap) {
+        // Update the points that do not depend on ghost cells while the
+        // faces are in flight, then the one cell thick shell around them
+        {
+            PhaseTimer timer(perf, PHASE_EXCHANGE, exchange_bytes);
+            exchange_begin(u, v);
+        }
+        {
+            PhaseTimer timer(perf, PHASE_COMPUTE, calc_bytes);
+            calc_box(u, v, u2, v2, 2, size_x, 2, size_y, 2, size_z);
+        }
+        {
+            PhaseTimer timer(perf, PHASE_EXCHANGE);
+            exchange_end();
+        }
+        {
+            PhaseTimer timer(perf, PHASE_COMPUTE);
+            calc_shell(u, v, u2, v2);
+        }
+    } else {
+        // With g ghost layers the halo is exchanged every g steps. In
+        // between, each step also updates the part of the ghost layers that
+        // is still valid, so the region computed shrinks by one cell per
+        // step.
+        if (ghost_step == 0) {
+            PhaseTimer timer(perf, PHASE_EXCHANGE, exchange_bytes);
+            exchange(u, v);
+        }
+        {
+            PhaseTimer timer(perf, PHASE_COMPUTE, calc_bytes);
+            calc(u, v, u2, v2, settings.ghost_width - 1 - ghost_step);
+        }
+        ghost_step = (ghost_step + 1) % settings.ghost_width;
+    }
+    step++;
 
-    u.swap(u2);
-    v.swap(v2);
+    std::swap(u, u2);
+    std::swap(v, v2);
 }
 
-std::vector<double> GrayScott::u_noghost() const { return data_noghost(u); }
+template <typename T>
+std::vector<T> GrayScott<T>::u_noghost() const { return data_noghost(u); }
 
-std::vector<double> GrayScott::v_noghost() const { return data_noghost(v); }
+template <typename T>
+std::vector<T> GrayScott<T>::v_noghost() const { return data_noghost(v); }
+
+template <typename T>
+void GrayScott<T>::u_noghost(T *buf, bool native) const
+{
+    if (native) {
+        data_noghost_native(u, buf);
+    } else {
+        data_noghost(u, buf);
+    }
+}
 
-std::vector<double>
-GrayScott::data_noghost(const std::vector<double> &data) const
+template <typename T>
+void GrayScott<T>::v_noghost(T *buf, bool native) const
 {
-    std::vector<double> buf(size_x * size_y * size_z);
+    if (native) {
+        data_noghost_native(v, buf);
+    } else {
+        data_noghost(v, buf);
+    }
+}
+
+template <typename T>
+void GrayScott<T>::u_extended(T *buf) const
+{
+    data_extended(u, buf);
+}
+
+template <typename T>
+void GrayScott<T>::v_extended(T *buf) const
+{
+    data_extended(v, buf);
+}
 
-    for (int x = 1; x < size_x + 1; x++) {
-        for (int y = 1; y < size_y + 1; y++) {
-            for (int z = 1; z < size_z + 1; z++) {
-                buf[(x - 1) + (y - 1) * size_x + (z - 1) * size_x * size_y] =
-                    data[l2i(x, y, z)];
+template <typename T>
+void GrayScott<T>::stats(FieldStats &u_stats, FieldStats &v_stats) const
+{
+    const int g = settings.ghost_width;
+    const int nx = size_x, ny = size_y, nz = size_z;
+
+    // Sums of the deviations from the first point keep the sum of squares
+    // accurate when the mean is much larger than the spread
+    const double u0 = u[l2i(g, g, g)];
+    const double v0 = v[l2i(g, g, g)];
+    double su = 0.0, su2 = 0.0, sv = 0.0, sv2 = 0.0;
+    double u_min = u0, u_max = u0, v_min = v0, v_max = v0;
+
+#pragma omp parallel for collapse(2) schedule(static) \
+    reduction(+ : su, su2, sv, sv2) reduction(min : u_min, v_min) \
+    reduction(max : u_max, v_max)
+    for (int x = 0; x < nx; x++) {
+        for (int y = 0; y < ny; y++) {
+#pragma omp simd reduction(+ : su, su2, sv, sv2) \
+    reduction(min : u_min, v_min) reduction(max : u_max, v_max)
+            for (int z = 0; z < nz; z++) {
+                const int i = l2i(x + g, y + g, z + g);
+                const double a = u[i];
+                const double b = v[i];
+                su += a - u0;
+                su2 += (a - u0) * (a - u0);
+                sv += b - v0;
+                sv2 += (b - v0) * (b - v0);
+                u_min = a < u_min ? a : u_min;
+                u_max = a > u_max ? a : u_max;
+                v_min = b < v_min ? b : v_min;
+                v_max = b > v_max ? b : v_max;
             }
         }
     }
 
+    const double n = static_cast<double>(nx) * ny * nz;
+    u_stats.count = n;
+    u_stats.mean = u0 + su / n;
+    u_stats.m2 = std::max(su2 - su * su / n, 0.0);
+    u_stats.min = u_min;
+    u_stats.max = u_max;
+    v_stats.count = n;
+    v_stats.mean = v0 + sv / n;
+    v_stats.m2 = std::max(sv2 - sv * sv / n, 0.0);
+    v_stats.min = v_min;
+    v_stats.max = v_max;
+}
+
+template <typename T>
+void GrayScott<T>::restore(int steps, const T *u_buf, const T *v_buf)
+{
+    const int g = settings.ghost_width;
+    const int nx = size_x, ny = size_y, nz = size_z;
+
+#pragma omp parallel for collapse(2) schedule(static)
+    for (int x = 0; x < nx; x++) {
+        for (int y = 0; y < ny; y++) {
+            const size_t r = (static_cast<size_t>(x) * ny + y) * nz;
+            for (int z = 0; z < nz; z++) {
+                const int i = l2i(x + g, y + g, z + g);
+                u[i] = u_buf[r + z];
+                v[i] = v_buf[r + z];
+            }
+        }
+    }
+
+    // The interior does not depend on when the halo was exchanged, so
+    // exchange it before the next step
+    step = steps;
+    ghost_step = 0;
+}
+
+template <typename T>
+const T *GrayScott<T>::u_ghosted() const
+{
+#ifdef GS_INTERLEAVED
+    return nullptr;
+#else
+    return u;
+#endif
+}
+
+template <typename T>
+const T *GrayScott<T>::v_ghosted() const
+{
+#ifdef GS_INTERLEAVED
+    return nullptr;
+#else
+    return v;
+#endif
+}
+
+template <typename T>
+std::vector<T> GrayScott<T>::data_noghost(const T *data) const
+{
+    std::vector<T> buf(size_x * size_y * size_z);
+    data_noghost(data, buf.data());
     return buf;
 }
 
-void GrayScott::init_field()
+template <typename T>
+void GrayScott<T>::data_noghost(const T *data, T *buf) const
+{
+    const int g = settings.ghost_width;
+    const int nx = size_x, ny = size_y, nz = size_z;
+    // The copy transposes every xz-plane (z fastest to x fastest). Going
+    // through it in square tiles keeps both the rows read and the rows
+    // written in cache.
+    const int tile = 32;
+
+#pragma omp parallel for collapse(2) schedule(static)
+    for (int y = 0; y < ny; y++) {
+        for (int tz = 0; tz < nz; tz += tile) {
+            const int ez = std::min(tz + tile, nz);
+            for (int tx = 0; tx < nx; tx += tile) {
+                const int ex = std::min(tx + tile, nx);
+                for (int z = tz; z < ez; z++) {
+                    T *dst = &buf[(static_cast<size_t>(z) * ny + y) * nx];
+                    for (int x = tx; x < ex; x++) {
+                        dst[x] = data[l2i(x + g, y + g, z + g)];
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <typename T>
+void GrayScott<T>::data_noghost_native(const T *data, T *buf) const
+{
+    const int g = settings.ghost_width;
+    const int nx = size_x, ny = size_y, nz = size_z;
+
+#pragma omp parallel for collapse(2) schedule(static)
+    for (int x = 0; x < nx; x++) {
+        for (int y = 0; y < ny; y++) {
+            T *dst = &buf[(static_cast<size_t>(x) * ny + y) * nz];
+            for (int z = 0; z < nz; z++) {
+                dst[z] = data[l2i(x + g, y + g, z + g)];
+            }
+        }
+    }
+}
+
+template <typename T>
+void GrayScott<T>::data_extended(const T *data, T *buf) const
 {
-    const int V = (size_x + 2) * (size_y + 2) * (size_z + 2);
-    u.resize(V, 1.0);
-    v.resize(V, 0.0);
-    u2.resize(V, 0.0);
-    v2.resize(V, 0.0);
+    const int g = settings.ghost_width;
+    const int nx = size_x, ny = size_y, nz = size_z;
+
+#pragma omp parallel for collapse(2) schedule(static)
+    for (int x = 0; x < nx; x++) {
+        for (int y = 0; y < ny; y++) {
+            T *dst = &buf[(static_cast<size_t>(x) * (ny + 1) + y) * (nz + 1)];
+            for (int z = 0; z < nz; z++) {
+                dst[z] = data[l2i(x + g, y + g, z + g)];
+            }
+        }
+    }
+
+    // Receive the first plane of the next process along z, then along y and
+    // x including the planes received before, which fills edges and corners
+    const int sizes[3] = {nx + 1, ny + 1, nz + 1};
+    const int neighbors[3][2] = {{west, east}, {down, up}, {south, north}};
+    for (int d = 2; d >= 0; d--) {
+        int count[3] = {nx, ny, nz};
+        for (int e = d + 1; e < 3; e++) {
+            count[e]++;
+        }
+        count[d] = 1;
+        int first[3] = {0, 0, 0};
+        MPI_Datatype send_type, recv_type;
+        MPI_Type_create_subarray(3, sizes, count, first, MPI_ORDER_C,
+                                 mpi_type<T>(), &send_type);
+        first[d] = sizes[d] - 1;
+        MPI_Type_create_subarray(3, sizes, count, first, MPI_ORDER_C,
+                                 mpi_type<T>(), &recv_type);
+        MPI_Type_commit(&send_type);
+        MPI_Type_commit(&recv_type);
+        MPI_Sendrecv(buf, 1, send_type, neighbors[d][0], 48 + d, buf, 1,
+                     recv_type, neighbors[d][1], 48 + d, cart_comm,
+                     MPI_STATUS_IGNORE);
+        MPI_Type_free(&send_type);
+        MPI_Type_free(&recv_type);
+    }
+}
+
+template <typename T>
+void GrayScott<T>::coarse_block(int f, size_t start[3], size_t count[3]) const
+{
+    const size_t offset[3] = {offset_x, offset_y, offset_z};
+    const size_t size[3] = {size_x, size_y, size_z};
+    for (int d = 0; d < 3; d++) {
+        start[d] = (offset[d] + f - 1) / f;
+        count[d] = (offset[d] + size[d] + f - 1) / f - start[d];
+    }
+}
+
+template <typename T>
+void GrayScott<T>::u_coarse(int f, T *buf, bool native) const
+{
+    data_coarse(u, f, buf, native);
+}
+
+template <typename T>
+void GrayScott<T>::v_coarse(int f, T *buf, bool native) const
+{
+    data_coarse(v, f, buf, native);
+}
+
+template <typename T>
+void GrayScott<T>::data_coarse(const T *data, int f, T *buf,
+                               bool native) const
+{
+    const int g = settings.ghost_width;
+    size_t start[3], count[3];
+    coarse_block(f, start, count);
+    const int cx = count[0], cy = count[1], cz = count[2];
+    // Local coordinate of the first point of the first cell
+    const int x0 = start[0] * f - offset_x;
+    const int y0 = start[1] * f - offset_y;
+    const int z0 = start[2] * f - offset_z;
+    const int nx = size_x, ny = size_y, nz = size_z;
+
+#pragma omp parallel for collapse(2) schedule(static)
+    for (int i = 0; i < cx; i++) {
+        for (int j = 0; j < cy; j++) {
+            const int xb = x0 + i * f, xe = std::min(xb + f, nx);
+            const int yb = y0 + j * f, ye = std::min(yb + f, ny);
+            for (int k = 0; k < cz; k++) {
+                const int zb = z0 + k * f, ze = std::min(zb + f, nz);
+                double sum = 0.0;
+                for (int x = xb; x < xe; x++) {
+                    for (int y = yb; y < ye; y++) {
+                        for (int z = zb; z < ze; z++) {
+                            sum += data[l2i(x + g, y + g, z + g)];
+                        }
+                    }
+                }
+                const size_t c = native
+                                     ? (static_cast<size_t>(i) * cy + j) * cz + k
+                                     : (static_cast<size_t>(k) * cy + j) * cx + i;
+                buf[c] = sum / ((xe - xb) * (ye - yb) * (ze - zb));
+            }
+        }
+    }
+}
+
+template <typename T>
+void GrayScott<T>::level_layout(const int size[3], size_t &level,
+                                size_t &v_offset) const
+{
+    const int g = settings.ghost_width;
+#ifdef GS_INTERLEAVED
+    level = l2i(size[0] + 2 * g, 0, 0, size[1], size[2]);
+    v_offset = interleave_block<T>();
+#else
+    level = 2 * l2i(size[0] + 2 * g, 0, 0, size[1], size[2]);
+    v_offset = level / 2;
+#endif
+}
+
+template <typename T>
+void GrayScott<T>::init_storage()
+{
+    const int size[3] = {static_cast<int>(size_x), static_cast<int>(size_y),
+                         static_cast<int>(size_z)};
+    size_t v_offset;
+    level_layout(size, level_size, v_offset);
+
+    if (settings.halo == "shared") {
+        // Every process contributes its fields to a window shared by the
+        // node. Non-contiguous allocation keeps each segment on its own
+        // pages, which are then placed by first touch in init_field.
+        MPI_Info info;
+        MPI_Info_create(&info);
+        MPI_Info_set(info, "alloc_shared_noncontig", "true");
+        MPI_Win_allocate_shared(2 * level_size * sizeof(T), sizeof(T), info,
+                                node_comm, &field_base, &field_win);
+        MPI_Info_free(&info);
+        advise_huge_pages(field_base, 2 * level_size * sizeof(T));
+        // Passive target epoch for MPI_Win_sync
+        MPI_Win_lock_all(MPI_MODE_NOCHECK, field_win);
+    } else {
+        // Not written yet, see init_field
+        field_storage.resize(2 * level_size);
+        field_base = field_storage.data();
+    }
+
+    u = field_base;
+    v = u + v_offset;
+    u2 = field_base + level_size;
+    v2 = u2 + v_offset;
+}
+
+template <typename T>
+void GrayScott<T>::init_field()
+{
+    const int g = settings.ghost_width;
+    const int nx = size_x + 2 * g, ny = size_y + 2 * g, nz = size_z + 2 * g;
+    const int bx = tile_x, by = tile_y, bz = tile_z;
+#ifdef GS_INTERLEAVED
+    // Rows are padded to whole blocks, write the padding as well
+    const int B = interleave_block<T>();
+    const int nz_row = (nz + B - 1) / B * B;
+#else
+    const int nz_row = nz;
+#endif
+
+    // The tiles of the interior and their schedule are those of calc_box,
+    // the ghost layers go with the tiles next to them
+#pragma omp parallel for collapse(3) schedule(static)
+    for (int tx = g; tx < nx - g; tx += bx) {
+        for (int ty = g; ty < ny - g; ty += by) {
+            for (int tz = g; tz < nz - g; tz += bz) {
+                const int sx = tx == g ? 0 : tx;
+                const int sy = ty == g ? 0 : ty;
+                const int sz = tz == g ? 0 : tz;
+                const int ex = tx + bx >= nx - g ? nx : tx + bx;
+                const int ey = ty + by >= ny - g ? ny : ty + by;
+                const int ez = tz + bz >= nz - g ? nz_row : tz + bz;
+
+                for (int x = sx; x < ex; x++) {
+                    for (int y = sy; y < ey; y++) {
+                        for (int z = sz; z < ez; z++) {
+                            const int i = l2i(x, y, z);
+                            u[i] = 1.0;
+                            v[i] = 0.0;
+                            u2[i] = 0.0;
+                            v2[i] = 0.0;
+                        }
+                    }
+                }
+            }
+        }
+    }
 
     const int d = 6;
     for (int x = settings.L / 2 - d; x < settings.L / 2 + d; x++) {
@@ -73,53 +633,166 @@ void GrayScott::init_field()
     }
 }
 
-double GrayScott::calcU(double tu, double tv) const
+template <typename T>
+void GrayScott<T>::init_exchange_bytes()
 {
-    return -tu * tv * tv + settings.F * (1.0 - tu);
+    exchange_bytes = 0;
+    if (settings.halo != "datatype") {
+        // Faces copied from the node count as well
+        for (const HaloFace &f : faces) {
+            exchange_bytes +=
+                2 * sizeof(T) * f.count[0] * f.count[1] * f.count[2];
+        }
+        return;
+    }
+
+    // Both fields, both directions
+    int yz, xz, xy;
+    MPI_Type_size(yz_face_type, &yz);
+    if (settings.halo_overlap) {
+        MPI_Type_size(xz_inner_face_type, &xz);
+        MPI_Type_size(xy_inner_face_type, &xy);
+    } else {
+        MPI_Type_size(xz_face_type, &xz);
+        MPI_Type_size(xy_face_type, &xy);
+    }
+    exchange_bytes = 4 * static_cast<uint64_t>(yz + xz + xy);
+}
+
+template <typename T>
+void GrayScott<T>::init_tiles()
+{
+    // Give every thread its own range of x-planes to sweep
+    tile_x = settings.tile_x > 0 ? settings.tile_x
+                                 : (size_x + nthreads - 1) / nthreads;
+    tile_z = settings.tile_z > 0 ? settings.tile_z : size_z;
+
+    if (settings.tile_y > 0) {
+        tile_y = settings.tile_y;
+    } else {
+        long cache_size = 0;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+        cache_size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+        if (cache_size <= 0) {
+            cache_size = 1024 * 1024;
+        }
+
+        // While sweeping x, a tile keeps three planes of u and v and one
+        // plane of u2 and v2 in use. Fill half of L2 with them.
+        const size_t row_bytes =
+            8 * (tile_z + 2 * settings.ghost_width) * sizeof(T);
+        const size_t rows = cache_size / 2 / row_bytes;
+        tile_y = rows > 2 ? rows - 2 : 1;
+    }
+
+    tile_x = std::min(std::max<size_t>(tile_x, 1), size_x);
+    tile_y = std::min(std::max<size_t>(tile_y, 1), size_y);
+    tile_z = std::min(std::max<size_t>(tile_z, 1), size_z);
 }
 
-double GrayScott::calcV(double tu, double tv) const
+template <typename T>
+void GrayScott<T>::calc(const T *u, const T *v, T *u2, T *v2,
+                     int e)
 {
-    return tu * tv * tv - (settings.F + settings.k) * tv;
+    // Region to update: the interior grown by e cells on each side
+    const int g = settings.ghost_width;
+    calc_box(u, v, u2, v2, g - e, size_x + g + e, g - e, size_y + g + e, g - e,
+             size_z + g + e);
 }
 
-double GrayScott::laplacian(int x, int y, int z,
-                            const std::vector<double> &s) const
+template <typename T>
+void GrayScott<T>::calc_shell(const T *u, const T *v, T *u2,
+                           T *v2)
 {
-    double ts = 0.0;
-    ts += s[l2i(x - 1, y, z)];
-    ts += s[l2i(x + 1, y, z)];
-    ts += s[l2i(x, y - 1, z)];
-    ts += s[l2i(x, y + 1, z)];
-    ts += s[l2i(x, y, z - 1)];
-    ts += s[l2i(x, y, z + 1)];
-    ts += -6.0 * s[l2i(x, y, z)];
+    // Only used with a single ghost layer, the interior is [1, size + 1)
+    const int x1 = size_x + 1, y1 = size_y + 1, z1 = size_z + 1;
 
-    return ts / 6.0;
+    // West and east planes
+    calc_box(u, v, u2, v2, 1, 2, 1, y1, 1, z1);
+    if (size_x > 1) {
+        calc_box(u, v, u2, v2, x1 - 1, x1, 1, y1, 1, z1);
+    }
+    // Down and up planes, without the points done above
+    calc_box(u, v, u2, v2, 2, x1 - 1, 1, 2, 1, z1);
+    if (size_y > 1) {
+        calc_box(u, v, u2, v2, 2, x1 - 1, y1 - 1, y1, 1, z1);
+    }
+    // South and north planes, without the points done above
+    calc_box(u, v, u2, v2, 2, x1 - 1, 2, y1 - 1, 1, 2);
+    if (size_z > 1) {
+        calc_box(u, v, u2, v2, 2, x1 - 1, 2, y1 - 1, z1 - 1, z1);
+    }
 }
 
-void GrayScott::calc(const std::vector<double> &u, const std::vector<double> &v,
-                     std::vector<double> &u2, std::vector<double> &v2)
+template <typename T>
+void GrayScott<T>::calc_box(const T *u, const T *v, T *u2,
+                         T *v2, int x0, int x1, int y0, int y1, int z0,
+                         int z1)
 {
-    for (int x = 1; x < size_x + 1; x++) {
-        for (int y = 1; y < size_y + 1; y++) {
-            for (int z = 1; z < size_z + 1; z++) {
-                const int i = l2i(x, y, z);
-                double du = 0.0;
-                double dv = 0.0;
-                du = settings.Du * laplacian(x, y, z, u);
-                dv = settings.Dv * laplacian(x, y, z, v);
-                du += calcU(u[i], v[i]);
-                dv += calcV(u[i], v[i]);
-                du += settings.noise * uniform_dist(mt_gen);
-                u2[i] = u[i] + du * settings.dt;
-                v2[i] = v[i] + dv * settings.dt;
+    if (x0 >= x1 || y0 >= y1 || z0 >= z1) {
+        return;
+    }
+
+    const KernelParams<T> p = {static_cast<T>(settings.Du),
+                               static_cast<T>(settings.Dv),
+                               static_cast<T>(settings.F),
+                               static_cast<T>(settings.F + settings.k),
+                               static_cast<T>(settings.dt),
+                               static_cast<T>(settings.noise),
+                               {static_cast<uint32_t>(settings.seed),
+                                static_cast<uint32_t>(settings.seed >> 32)}};
+    // Distance between neighbors in x and y
+    const ptrdiff_t sx = l2i(1, 0, 0);
+    const ptrdiff_t sy = l2i(0, 1, 0);
+#ifdef GS_INTERLEAVED
+    const typename Kernel<T>::calc_row_t calc_row =
+        kernel.calc_row_interleaved;
+#else
+    const typename Kernel<T>::calc_row_t calc_row = kernel.calc_row;
+#endif
+
+    // Global coordinate of local coordinate 0, wrapped into [0, L)
+    const int g = settings.ghost_width;
+    const int L = settings.L;
+    const int ox = offset_x - g + L;
+    const int oy = offset_y - g + L;
+    const int oz = offset_z - g + L;
+
+    const int bx = tile_x, by = tile_y, bz = tile_z;
+
+#pragma omp parallel for collapse(3) schedule(static)
+    for (int tx = x0; tx < x1; tx += bx) {
+        for (int ty = y0; ty < y1; ty += by) {
+            for (int tz = z0; tz < z1; tz += bz) {
+                const int ex = std::min(tx + bx, x1);
+                const int ey = std::min(ty + by, y1);
+                const int ez = std::min(tz + bz, z1);
+
+                for (int x = tx; x < ex; x++) {
+                    for (int y = ty; y < ey; y++) {
+                        NoiseCounter c = {static_cast<uint32_t>((ox + x) % L),
+                                          static_cast<uint32_t>((oy + y) % L),
+                                          0, static_cast<uint32_t>(step)};
+                        // Split the row where the global z coordinate wraps
+                        // around, the noise counter must stay in [0, L)
+                        for (int z = tz; z < ez;) {
+                            c.z = (oz + z) % L;
+                            const int n = std::min<int>(ez - z, L - c.z);
+                            const int r = l2i(x, y, 0);
+                            calc_row(&u[r], &v[r], &u2[r], &v2[r], z, n, sx,
+                                     sy, p, c);
+                            z += n;
+                        }
+                    }
+                }
             }
         }
     }
 }
 
-void GrayScott::init_mpi()
+template <typename T>
+void GrayScott<T>::init_mpi()
 {
     int dims[3] = {};
     const int periods[3] = {1, 1, 1};
@@ -128,88 +801,488 @@ void GrayScott::init_mpi()
     MPI_Comm_rank(comm, &rank);
     MPI_Comm_size(comm, &procs);
 
-    MPI_Dims_create(procs, 3, dims);
+    // Every block needs at least ghost_width points along each axis, checked
+    // before any datatype is built for the blocks
+    if (!choose_dims(procs, settings.L, settings.ghost_width, dims)) {
+        if (rank == 0) {
+            std::cerr << "No process grid for L " << settings.L << " on "
+                      << procs << " processes has at least ghost_width "
+                      << settings.ghost_width << " points per process"
+                      << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
     npx = dims[0];
     npy = dims[1];
     npz = dims[2];
-    size_x = settings.L / npx;
-    size_y = settings.L / npy;
-    size_z = settings.L / npz;
 
-    MPI_Cart_create(comm, 3, dims, periods, 0, &cart_comm);
+    // Give each node a compact box of the process grid, so that most faces
+    // are exchanged within the node. Processes are numbered x slowest in the
+    // Cartesian communicator.
+    std::vector<int> node_of;
+    int node_rank, node_size;
+    const bool even = find_nodes(comm, node_of, node_rank, node_size);
+    const int node = node_of[rank];
+    int tile[3];
+    int cart_rank = rank;
+    if (settings.node_aware && even &&
+        choose_node_tile(dims, settings.L, node_size, tile)) {
+        const int nodes[3] = {dims[0] / tile[0], dims[1] / tile[1],
+                              dims[2] / tile[2]};
+        const int node_coords[3] = {node / (nodes[1] * nodes[2]),
+                                    node / nodes[2] % nodes[1],
+                                    node % nodes[2]};
+        const int local_coords[3] = {node_rank / (tile[1] * tile[2]),
+                                     node_rank / tile[2] % tile[1],
+                                     node_rank % tile[2]};
+        for (int d = 0; d < 3; d++) {
+            coords[d] = node_coords[d] * tile[d] + local_coords[d];
+        }
+        cart_rank = (coords[0] * dims[1] + coords[1]) * dims[2] + coords[2];
+    }
+
+    MPI_Comm ordered_comm;
+    MPI_Comm_split(comm, 0, cart_rank, &ordered_comm);
+    MPI_Cart_create(ordered_comm, 3, dims, periods, 0, &cart_comm);
+    MPI_Comm_free(&ordered_comm);
+    MPI_Comm_rank(cart_comm, &rank);
     MPI_Cart_coords(cart_comm, rank, 3, coords);
     px = coords[0];
     py = coords[1];
     pz = coords[2];
 
+    split_axis(settings.L, npx, px, size_x, offset_x);
+    split_axis(settings.L, npy, py, size_y, offset_y);
+    split_axis(settings.L, npz, pz, size_z, offset_z);
+
     MPI_Cart_shift(cart_comm, 0, 1, &west, &east);
     MPI_Cart_shift(cart_comm, 1, 1, &down, &up);
     MPI_Cart_shift(cart_comm, 2, 1, &south, &north);
 
-    // XY faces: (size_x + 2) * (size_y + 2)
-    MPI_Type_vector((size_x + 2) * (size_y + 2), 1, size_z + 2, MPI_DOUBLE,
-                    &xy_face_type);
-    MPI_Type_commit(&xy_face_type);
+    // Halo bytes of all processes per exchange that stay on a node and that
+    // cross nodes. Ghost edges and corners are left out.
+    std::vector<int> cart_node(procs);
+    MPI_Allgather(&node, 1, MPI_INT, cart_node.data(), 1, MPI_INT, cart_comm);
+    const int neighbors[6] = {west, east, down, up, south, north};
+    const uint64_t face_points[3] = {size_y * size_z, size_x * size_z,
+                                     size_x * size_y};
+    uint64_t halo_bytes[2] = {0, 0};
+    for (int d = 0; d < 6; d++) {
+        const uint64_t bytes = 2 * sizeof(T) * settings.ghost_width *
+                               face_points[d / 2];
+        halo_bytes[cart_node[neighbors[d]] == node ? 0 : 1] += bytes;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, halo_bytes, 2, MPI_UINT64_T, MPI_SUM,
+                  cart_comm);
+    halo_bytes_on_node = halo_bytes[0];
+    halo_bytes_off_node = halo_bytes[1];
 
-    // XZ faces: loca_size_x * size_z
-    MPI_Type_vector(size_x, size_z, (size_y + 2) * (size_z + 2), MPI_DOUBLE,
-                    &xz_face_type);
-    MPI_Type_commit(&xz_face_type);
+    // Faces are slabs of the ghosted local array that are ghost_width cells
+    // thick. They are exchanged in x, y, z order and each face spans the
+    // ghost layers of the directions exchanged before it, so that edges and
+    // corners are filled as well.
+    const int g = settings.ghost_width;
+    const int sizes[3] = {static_cast<int>(size_x) + 2 * g,
+                          static_cast<int>(size_y) + 2 * g,
+                          static_cast<int>(size_z) + 2 * g};
+    const int starts[3] = {0, 0, 0};
 
-    // YZ faces: (loca_size_y + 2) * size_z
-    MPI_Type_vector(size_y + 2, size_z, size_z + 2, MPI_DOUBLE, &yz_face_type);
+    // YZ faces: g * size_y * size_z
+    const int yz_sizes[3] = {g, static_cast<int>(size_y),
+                             static_cast<int>(size_z)};
+    MPI_Type_create_subarray(3, sizes, yz_sizes, starts, MPI_ORDER_C,
+                             mpi_type<T>(), &yz_face_type);
     MPI_Type_commit(&yz_face_type);
+
+    // XZ faces: (size_x + 2g) * g * size_z
+    const int xz_sizes[3] = {sizes[0], g, static_cast<int>(size_z)};
+    MPI_Type_create_subarray(3, sizes, xz_sizes, starts, MPI_ORDER_C,
+                             mpi_type<T>(), &xz_face_type);
+    MPI_Type_commit(&xz_face_type);
+
+    // XY faces: (size_x + 2g) * (size_y + 2g) * g
+    const int xy_sizes[3] = {sizes[0], sizes[1], g};
+    MPI_Type_create_subarray(3, sizes, xy_sizes, starts, MPI_ORDER_C,
+                             mpi_type<T>(), &xy_face_type);
+    MPI_Type_commit(&xy_face_type);
+
+    // Faces restricted to the interior, for the overlapped exchange that
+    // sends all faces at once
+    const int xz_inner_sizes[3] = {static_cast<int>(size_x), g,
+                                   static_cast<int>(size_z)};
+    MPI_Type_create_subarray(3, sizes, xz_inner_sizes, starts, MPI_ORDER_C,
+                             mpi_type<T>(), &xz_inner_face_type);
+    MPI_Type_commit(&xz_inner_face_type);
+
+    const int xy_inner_sizes[3] = {static_cast<int>(size_x),
+                                   static_cast<int>(size_y), g};
+    MPI_Type_create_subarray(3, sizes, xy_inner_sizes, starts, MPI_ORDER_C,
+                             mpi_type<T>(), &xy_inner_face_type);
+    MPI_Type_commit(&xy_inner_face_type);
+
+    if (settings.halo == "shared") {
+        MPI_Comm_split_type(cart_comm, MPI_COMM_TYPE_SHARED, rank,
+                            MPI_INFO_NULL, &node_comm);
+    }
+}
+
+template <typename T>
+void GrayScott<T>::init_halo_faces()
+{
+    const int g = settings.ghost_width;
+    const int size[3] = {static_cast<int>(size_x), static_cast<int>(size_y),
+                         static_cast<int>(size_z)};
+    const int lo[3] = {west, down, south};
+    const int hi[3] = {east, up, north};
+
+    MPI_Group cart_group, node_group;
+    if (settings.halo == "shared") {
+        MPI_Comm_group(cart_comm, &cart_group);
+        MPI_Comm_group(node_comm, &node_group);
+    }
+
+    for (int d = 0; d < 6; d++) {
+        HaloFace &f = faces[d];
+        const int a = d / 2;
+        const bool positive = d % 2 == 0;
+
+        for (int b = 0; b < 3; b++) {
+            if (b == a) {
+                f.count[b] = g;
+                f.send_start[b] = positive ? size[b] : g;
+                f.recv_start[b] = positive ? 0 : size[b] + g;
+            } else if (b < a && !settings.halo_overlap) {
+                // Include the ghost layers filled by the earlier phases
+                f.count[b] = size[b] + 2 * g;
+                f.send_start[b] = 0;
+                f.recv_start[b] = 0;
+            } else {
+                f.count[b] = size[b];
+                f.send_start[b] = g;
+                f.recv_start[b] = g;
+            }
+        }
+        f.send_to = positive ? hi[a] : lo[a];
+        f.recv_from = positive ? lo[a] : hi[a];
+
+        // Faces from the process itself (periodic axis with one process)
+        // and, with the shared exchange, from processes on the same node are
+        // read directly from their fields instead of being sent
+        int node_ranks[2] = {MPI_UNDEFINED, MPI_UNDEFINED};
+        if (settings.halo == "shared") {
+            const int ranks[2] = {f.send_to, f.recv_from};
+            MPI_Group_translate_ranks(cart_group, 2, ranks, node_group,
+                                      node_ranks);
+        }
+
+        f.peer_base = nullptr;
+        if (f.recv_from == rank) {
+            f.peer_base = field_base;
+        } else if (node_ranks[1] != MPI_UNDEFINED) {
+            MPI_Aint bytes;
+            int disp_unit;
+            MPI_Win_shared_query(field_win, node_ranks[1], &bytes, &disp_unit,
+                                 &f.peer_base);
+        }
+
+        // The neighbor has the same size as this process except along a,
+        // where it sends its last layers in the positive direction
+        int peer_coords[3];
+        MPI_Cart_coords(cart_comm, f.recv_from, 3, peer_coords);
+        size_t peer_size, peer_offset;
+        split_axis(settings.L, a == 0 ? npx : a == 1 ? npy : npz,
+                   peer_coords[a], peer_size, peer_offset);
+        for (int b = 0; b < 3; b++) {
+            f.peer_size[b] = b == a ? peer_size : size[b];
+            f.peer_start[b] = f.send_start[b];
+        }
+        if (positive) {
+            f.peer_start[a] = f.peer_size[a];
+        }
+
+        // One message carries the face of u followed by the face of v
+        const int n = 2 * f.count[0] * f.count[1] * f.count[2];
+        f.req[0] = MPI_REQUEST_NULL;
+        f.req[1] = MPI_REQUEST_NULL;
+        if (f.peer_base == nullptr) {
+            f.recv_buf.resize(n);
+            MPI_Recv_init(f.recv_buf.data(), n, mpi_type<T>(), f.recv_from, 32 + d,
+                          cart_comm, &f.req[0]);
+        }
+        if (f.send_to != rank && node_ranks[0] == MPI_UNDEFINED) {
+            f.send_buf.resize(n);
+            MPI_Send_init(f.send_buf.data(), n, mpi_type<T>(), f.send_to, 32 + d,
+                          cart_comm, &f.req[1]);
+        }
+    }
+
+    if (settings.halo == "shared") {
+        MPI_Group_free(&cart_group);
+        MPI_Group_free(&node_group);
+    }
+}
+
+template <typename T>
+void GrayScott<T>::pack_face(const HaloFace &f, const T *data,
+                          T *buf) const
+{
+    const int nx = f.count[0], ny = f.count[1], nz = f.count[2];
+
+#pragma omp parallel for if (nx * ny * nz > 65536)
+    for (int x = 0; x < nx; x++) {
+        for (int y = 0; y < ny; y++) {
+            const int sx = f.send_start[0] + x, sy = f.send_start[1] + y;
+            T *dst = &buf[(x * ny + y) * nz];
+            for (int z = 0; z < nz; z++) {
+                dst[z] = data[l2i(sx, sy, f.send_start[2] + z)];
+            }
+        }
+    }
+}
+
+template <typename T>
+void GrayScott<T>::unpack_face(const HaloFace &f, const T *buf,
+                            T *data) const
+{
+    const int nx = f.count[0], ny = f.count[1], nz = f.count[2];
+
+#pragma omp parallel for if (nx * ny * nz > 65536)
+    for (int x = 0; x < nx; x++) {
+        for (int y = 0; y < ny; y++) {
+            const int rx = f.recv_start[0] + x, ry = f.recv_start[1] + y;
+            const T *src = &buf[(x * ny + y) * nz];
+            for (int z = 0; z < nz; z++) {
+                data[l2i(rx, ry, f.recv_start[2] + z)] = src[z];
+            }
+        }
+    }
+}
+
+template <typename T>
+void GrayScott<T>::copy_face(const HaloFace &f, const T *peer,
+                          T *data) const
+{
+    const int nx = f.count[0], ny = f.count[1], nz = f.count[2];
+
+#pragma omp parallel for if (nx * ny * nz > 65536)
+    for (int x = 0; x < nx; x++) {
+        for (int y = 0; y < ny; y++) {
+            const int sx = f.peer_start[0] + x, sy = f.peer_start[1] + y;
+            const int rx = f.recv_start[0] + x, ry = f.recv_start[1] + y;
+            for (int z = 0; z < nz; z++) {
+                data[l2i(rx, ry, f.recv_start[2] + z)] =
+                    peer[l2i(sx, sy, f.peer_start[2] + z, f.peer_size[1],
+                             f.peer_size[2])];
+            }
+        }
+    }
+}
+
+template <typename T>
+void GrayScott<T>::sync_node() const
+{
+    if (field_win == MPI_WIN_NULL) {
+        return;
+    }
+
+    MPI_Win_sync(field_win);
+    MPI_Barrier(node_comm);
+    MPI_Win_sync(field_win);
+}
+
+template <typename T>
+void GrayScott<T>::start_faces(int first, int last, T *u, T *v)
+{
+    for (int d = first; d < last; d++) {
+        HaloFace &f = faces[d];
+
+        if (f.req[0] != MPI_REQUEST_NULL) {
+            MPI_Start(&f.req[0]);
+        }
+        if (f.req[1] != MPI_REQUEST_NULL) {
+            const size_t n = f.send_buf.size() / 2;
+            pack_face(f, u, &f.send_buf[0]);
+            pack_face(f, v, &f.send_buf[n]);
+            MPI_Start(&f.req[1]);
+        }
+        if (f.peer_base != nullptr) {
+            // The peer is in the same step, so its current fields are in the
+            // same time level as ours
+            size_t peer_level, peer_v_offset;
+            level_layout(f.peer_size, peer_level, peer_v_offset);
+            const T *peer_u =
+                f.peer_base + (u >= field_base + level_size ? peer_level : 0);
+            copy_face(f, peer_u, u);
+            copy_face(f, peer_u + peer_v_offset, v);
+        }
+    }
+}
+
+template <typename T>
+void GrayScott<T>::finish_faces(int first, int last, T *u, T *v)
+{
+    for (int d = first; d < last; d++) {
+        HaloFace &f = faces[d];
+        if (f.req[0] == MPI_REQUEST_NULL && f.req[1] == MPI_REQUEST_NULL) {
+            continue;
+        }
+
+        MPI_Waitall(2, f.req, MPI_STATUSES_IGNORE);
+        if (f.peer_base == nullptr) {
+            const size_t n = f.recv_buf.size() / 2;
+            unpack_face(f, &f.recv_buf[0], u);
+            unpack_face(f, &f.recv_buf[n], v);
+        }
+    }
 }
 
-void GrayScott::exchange_xy(std::vector<double> &local_data) const
+template <typename T>
+void GrayScott<T>::exchange_xy(T *local_data) const
 {
     MPI_Status st;
+    const int g = settings.ghost_width;
 
-    // Send XY face z=size_z to north and receive z=0 from south
+    // Send XY faces z=size_z..size_z+g-1 to north and receive z=0..g-1 from
+    // south
     MPI_Sendrecv(&local_data[l2i(0, 0, size_z)], 1, xy_face_type, north, 1,
                  &local_data[l2i(0, 0, 0)], 1, xy_face_type, south, 1,
                  cart_comm, &st);
-    // Send XY face z=1 to south and receive z=size_z+1 from north
-    MPI_Sendrecv(&local_data[l2i(0, 0, 1)], 1, xy_face_type, south, 1,
-                 &local_data[l2i(0, 0, size_z + 1)], 1, xy_face_type, north, 1,
+    // Send XY faces z=g..2g-1 to south and receive z=size_z+g..size_z+2g-1
+    // from north
+    MPI_Sendrecv(&local_data[l2i(0, 0, g)], 1, xy_face_type, south, 1,
+                 &local_data[l2i(0, 0, size_z + g)], 1, xy_face_type, north, 1,
                  cart_comm, &st);
 }
 
-void GrayScott::exchange_xz(std::vector<double> &local_data) const
+template <typename T>
+void GrayScott<T>::exchange_xz(T *local_data) const
 {
     MPI_Status st;
+    const int g = settings.ghost_width;
 
-    // Send XZ face y=size_y to up and receive y=0 from down
-    MPI_Sendrecv(&local_data[l2i(1, size_y, 1)], 1, xz_face_type, up, 2,
-                 &local_data[l2i(1, 0, 1)], 1, xz_face_type, down, 2, cart_comm,
+    // Send XZ faces y=size_y..size_y+g-1 to up and receive y=0..g-1 from down
+    MPI_Sendrecv(&local_data[l2i(0, size_y, g)], 1, xz_face_type, up, 2,
+                 &local_data[l2i(0, 0, g)], 1, xz_face_type, down, 2, cart_comm,
                  &st);
-    // Send XZ face y=1 to down and receive y=size_y+1 from up
-    MPI_Sendrecv(&local_data[l2i(1, 1, 1)], 1, xz_face_type, down, 2,
-                 &local_data[l2i(1, size_y + 1, 1)], 1, xz_face_type, up, 2,
+    // Send XZ faces y=g..2g-1 to down and receive y=size_y+g..size_y+2g-1
+    // from up
+    MPI_Sendrecv(&local_data[l2i(0, g, g)], 1, xz_face_type, down, 2,
+                 &local_data[l2i(0, size_y + g, g)], 1, xz_face_type, up, 2,
                  cart_comm, &st);
 }
 
-void GrayScott::exchange_yz(std::vector<double> &local_data) const
+template <typename T>
+void GrayScott<T>::exchange_yz(T *local_data) const
 {
     MPI_Status st;
+    const int g = settings.ghost_width;
 
-    // Send YZ face x=size_x to east and receive x=0 from west
-    MPI_Sendrecv(&local_data[l2i(size_x, 0, 1)], 1, yz_face_type, east, 3,
-                 &local_data[l2i(0, 0, 1)], 1, yz_face_type, west, 3, cart_comm,
+    // Send YZ faces x=size_x..size_x+g-1 to east and receive x=0..g-1 from
+    // west
+    MPI_Sendrecv(&local_data[l2i(size_x, g, g)], 1, yz_face_type, east, 3,
+                 &local_data[l2i(0, g, g)], 1, yz_face_type, west, 3, cart_comm,
                  &st);
-    // Send YZ face x=1 to west and receive x=size_x+1 from east
-    MPI_Sendrecv(&local_data[l2i(1, 0, 1)], 1, yz_face_type, west, 3,
-                 &local_data[l2i(size_x + 1, 0, 1)], 1, yz_face_type, east, 3,
+    // Send YZ faces x=g..2g-1 to west and receive x=size_x+g..size_x+2g-1
+    // from east
+    MPI_Sendrecv(&local_data[l2i(g, g, g)], 1, yz_face_type, west, 3,
+                 &local_data[l2i(size_x + g, g, g)], 1, yz_face_type, east, 3,
                  cart_comm, &st);
 }
 
-void GrayScott::exchange(std::vector<double> &u, std::vector<double> &v) const
+template <typename T>
+void GrayScott<T>::exchange(T *u, T *v)
 {
-    exchange_xy(u);
-    exchange_xz(u);
+    if (settings.halo != "datatype") {
+        // One phase per axis, both directions of an axis are in flight
+        // together. With the shared exchange, the barriers make sure that
+        // the processes on the node have finished writing what is read in
+        // the next phase. With several ghost layers the fields read here are
+        // overwritten before the next exchange, so wait for all reads too.
+        for (int a = 0; a < 3; a++) {
+            sync_node();
+            start_faces(2 * a, 2 * a + 2, u, v);
+            finish_faces(2 * a, 2 * a + 2, u, v);
+        }
+        if (settings.ghost_width > 1) {
+            sync_node();
+        }
+        return;
+    }
+
     exchange_yz(u);
+    exchange_xz(u);
+    exchange_xy(u);
 
-    exchange_xy(v);
-    exchange_xz(v);
     exchange_yz(v);
+    exchange_xz(v);
+    exchange_xy(v);
 }
+
+template <typename T>
+void GrayScott<T>::exchange_begin(T *u, T *v)
+{
+    if (settings.halo != "datatype") {
+        // The fields read from the neighbors on the node are overwritten in
+        // the next step at the earliest, after the next exchange_begin has
+        // passed this barrier again
+        sync_node();
+        start_faces(0, 6, u, v);
+        halo_fields[0] = u;
+        halo_fields[1] = v;
+        return;
+    }
+
+    T *fields[2] = {u, v};
+    MPI_Request *req = halo_requests;
+
+    for (int f = 0; f < 2; f++) {
+        T *data = fields[f];
+        // The tag encodes the field and the direction the face travels in,
+        // so messages stay apart when both neighbors are the same process
+        const int tag = 16 + 6 * f;
+
+        // YZ faces, +x and -x
+        MPI_Irecv(&data[l2i(0, 1, 1)], 1, yz_face_type, west, tag + 0,
+                  cart_comm, req++);
+        MPI_Irecv(&data[l2i(size_x + 1, 1, 1)], 1, yz_face_type, east, tag + 1,
+                  cart_comm, req++);
+        MPI_Isend(&data[l2i(size_x, 1, 1)], 1, yz_face_type, east, tag + 0,
+                  cart_comm, req++);
+        MPI_Isend(&data[l2i(1, 1, 1)], 1, yz_face_type, west, tag + 1,
+                  cart_comm, req++);
+
+        // XZ faces, +y and -y
+        MPI_Irecv(&data[l2i(1, 0, 1)], 1, xz_inner_face_type, down, tag + 2,
+                  cart_comm, req++);
+        MPI_Irecv(&data[l2i(1, size_y + 1, 1)], 1, xz_inner_face_type, up,
+                  tag + 3, cart_comm, req++);
+        MPI_Isend(&data[l2i(1, size_y, 1)], 1, xz_inner_face_type, up, tag + 2,
+                  cart_comm, req++);
+        MPI_Isend(&data[l2i(1, 1, 1)], 1, xz_inner_face_type, down, tag + 3,
+                  cart_comm, req++);
+
+        // XY faces, +z and -z
+        MPI_Irecv(&data[l2i(1, 1, 0)], 1, xy_inner_face_type, south, tag + 4,
+                  cart_comm, req++);
+        MPI_Irecv(&data[l2i(1, 1, size_z + 1)], 1, xy_inner_face_type, north,
+                  tag + 5, cart_comm, req++);
+        MPI_Isend(&data[l2i(1, 1, size_z)], 1, xy_inner_face_type, north,
+                  tag + 4, cart_comm, req++);
+        MPI_Isend(&data[l2i(1, 1, 1)], 1, xy_inner_face_type, south, tag + 5,
+                  cart_comm, req++);
+    }
+}
+
+template <typename T>
+void GrayScott<T>::exchange_end()
+{
+    if (settings.halo != "datatype") {
+        finish_faces(0, 6, halo_fields[0], halo_fields[1]);
+        return;
+    }
+
+    MPI_Waitall(24, halo_requests, MPI_STATUSES_IGNORE);
+}
+
+template class GrayScott<double>;
+template class GrayScott<float>;
@@ -1,13 +1,18 @@
 #ifndef __GRAY_SCOTT_H__
 #define __GRAY_SCOTT_H__
 
-#include <random>
 #include <vector>
 
 #include <mpi.h>
 
+#include "allocator.h"
+#include "kernel.h"
+#include "perf.h"
 #include "settings.h"
+#include "stats.h"
 
+// Solver for u and v of type T (float or double)
+template <typename T>
 class GrayScott
 {
 public:
@@ -17,68 +22,192 @@ public:
     size_t px, py, pz;
     // Dimension of local array
     size_t size_x, size_y, size_z;
+    // Global coordinate of the first point of the local array
+    size_t offset_x, offset_y, offset_z;
+    // Stencil kernel selected for this CPU
+    Kernel<T> kernel;
+    // Number of threads used by calc
+    int nthreads;
+    // Dimension of cache blocks used by calc
+    size_t tile_x, tile_y, tile_z;
+    // Bytes of one halo exchange of all processes between processes on the
+    // same node and across nodes
+    uint64_t halo_bytes_on_node, halo_bytes_off_node;
+    // Receives the time of the update and the halo exchange if set
+    Perf *perf = nullptr;
 
     GrayScott(const Settings &settings, MPI_Comm comm);
     ~GrayScott();
 
     void init();
     void iterate();
-    std::vector<double> u_noghost() const;
-    std::vector<double> v_noghost() const;
+    std::vector<T> u_noghost() const;
+    std::vector<T> v_noghost() const;
+    // Copy u or v without ghosts into buf of size_x * size_y * size_z points,
+    // with x fastest, or with z fastest like the solver if native is set
+    void u_noghost(T *buf, bool native = false) const;
+    void v_noghost(T *buf, bool native = false) const;
+    // Block of this process in the grid of cells of f^3 points: the cells
+    // whose first point is in the local array, {x, y, z}
+    void coarse_block(int f, size_t start[3], size_t count[3]) const;
+    // Average u or v over the cells of coarse_block into buf, with x fastest,
+    // or with z fastest if native is set. Cells that reach past the local
+    // array are averaged over the points inside it.
+    void u_coarse(int f, T *buf, bool native = false) const;
+    void v_coarse(int f, T *buf, bool native = false) const;
+    // Copy u or v into buf of (size_x + 1) * (size_y + 1) * (size_z + 1)
+    // points, z fastest. The last plane along each axis holds the first
+    // plane of the next process, of the first process behind the last one.
+    // Collective over all processes.
+    void u_extended(T *buf) const;
+    void v_extended(T *buf) const;
+    // Statistics of u and v of this process, from one pass over both
+    void stats(FieldStats &u_stats, FieldStats &v_stats) const;
+    // Continue from u and v without ghosts, z fastest, after the given
+    // number of steps
+    void restore(int steps, const T *u_buf, const T *v_buf);
+    // u or v including the ghost layers, z fastest. nullptr if u and v are
+    // interleaved.
+    const T *u_ghosted() const;
+    const T *v_ghosted() const;
 
 protected:
     Settings settings;
 
-    std::vector<double> u, v, u2, v2;
+    // Current and next u and v, including ghost layers. Point (x, y, z) of u
+    // is u[l2i(x, y, z)], the same for v, u2 and v2.
+    T *u, *v, *u2, *v2;
+    // Number of values of u and v of one time level
+    size_t level_size;
+    // Memory of both time levels, unless they live in field_win
+    std::vector<T, FieldAllocator<T>> field_storage;
 
     int rank, procs;
     int west, east, up, down, north, south;
     MPI_Comm comm;
     MPI_Comm cart_comm;
 
+    // Processes on the same node and the shared memory window that holds
+    // their fields, used by the shared halo exchange
+    MPI_Comm node_comm = MPI_COMM_NULL;
+    MPI_Win field_win = MPI_WIN_NULL;
+    // First of the four fields of this process
+    T *field_base;
+
     // MPI datatypes for halo exchange
     MPI_Datatype xy_face_type;
     MPI_Datatype xz_face_type;
     MPI_Datatype yz_face_type;
+    // Faces without ghost cells, used by the overlapped exchange
+    MPI_Datatype xy_inner_face_type;
+    MPI_Datatype xz_inner_face_type;
+    // Pending sends and receives of the overlapped exchange
+    MPI_Request halo_requests[24];
+
+    // Face of the packed halo exchange that travels in one direction. Faces
+    // are ordered +x, -x, +y, -y, +z, -z.
+    struct HaloFace
+    {
+        // Ranks the face is sent to and received from
+        int send_to, recv_from;
+        // Local coordinate of the first point sent and received
+        int send_start[3], recv_start[3];
+        // Number of points in x, y and z
+        int count[3];
+        // Faces of u and v back to back
+        std::vector<T> send_buf, recv_buf;
+        // Persistent receive and send request
+        MPI_Request req[2];
+        // Fields of the process we receive from if its memory can be read
+        // directly, nullptr otherwise
+        T *peer_base;
+        // Local dimension of that process and the coordinate of the first
+        // point it would send
+        int peer_size[3];
+        int peer_start[3];
+    };
+    HaloFace faces[6];
+    // Bytes of u and v sent by one halo exchange
+    uint64_t exchange_bytes;
+    void init_exchange_bytes();
+    // Fields being exchanged by exchange_begin
+    T *halo_fields[2];
 
-    std::random_device rand_dev;
-    std::mt19937 mt_gen;
-    std::uniform_real_distribution<double> uniform_dist;
+    // Allocate the fields and set u, v, u2 and v2
+    void init_storage();
+    // Number of values of one time level of a block of size[3] points and
+    // the distance from u to v
+    void level_layout(const int size[3], size_t &level, size_t &v_offset) const;
+
+    // Number of steps taken, used as counter of the noise generator
+    int step = 0;
 
     // Setup cartesian communicator data types
     void init_mpi();
-    // Setup initial conditions
+    // Setup initial conditions. Every thread writes the tiles it updates in
+    // calc first, which places their pages on its NUMA node.
     void init_field();
+    // Choose cache block dimensions
+    void init_tiles();
+
+    // Steps taken since the last halo exchange
+    int ghost_step = 0;
 
-    // Progess simulation for one timestep
-    void calc(const std::vector<double> &u, const std::vector<double> &v,
-              std::vector<double> &u2, std::vector<double> &v2);
-    // Compute reaction term for U
-    double calcU(double tu, double tv) const;
-    // Compute reaction term for V
-    double calcV(double tu, double tv) const;
-    // Compute laplacian of field s at (ix, iy, iz)
-    double laplacian(int ix, int iy, int iz,
-                     const std::vector<double> &s) const;
+    // Progess simulation for one timestep. Updates the interior and e cells
+    // of the ghost layers around it.
+    void calc(const T *u, const T *v, T *u2, T *v2, int e);
+    // Update the box [x0, x1) * [y0, y1) * [z0, z1) of local coordinates
+    void calc_box(const T *u, const T *v, T *u2, T *v2, int x0, int x1,
+                  int y0, int y1, int z0, int z1);
+    // Update the outermost layer of interior points
+    void calc_shell(const T *u, const T *v, T *u2, T *v2);
 
     // Exchange faces with neighbors
-    void exchange(std::vector<double> &u, std::vector<double> &v) const;
+    void exchange(T *u, T *v);
     // Exchange XY faces with north/south
-    void exchange_xy(std::vector<double> &local_data) const;
+    void exchange_xy(T *local_data) const;
     // Exchange XZ faces with up/down
-    void exchange_xz(std::vector<double> &local_data) const;
+    void exchange_xz(T *local_data) const;
     // Exchange YZ faces with west/east
-    void exchange_yz(std::vector<double> &local_data) const;
+    void exchange_yz(T *local_data) const;
+    // Start sending and receiving all faces of u and v at once. Requires a
+    // single ghost layer, edges and corners are not exchanged.
+    void exchange_begin(T *u, T *v);
+    // Wait for the exchange started by exchange_begin
+    void exchange_end();
+
+    // Setup faces and persistent requests of the packed exchange
+    void init_halo_faces();
+    // Copy the points of a face into a contiguous buffer
+    void pack_face(const HaloFace &f, const T *data, T *buf) const;
+    // Copy a contiguous buffer into the ghost points of a face
+    void unpack_face(const HaloFace &f, const T *buf, T *data) const;
+    // Copy the points of a face of peer directly into the ghost points
+    void copy_face(const HaloFace &f, const T *peer, T *data) const;
+    // Make the fields written by the processes on this node visible
+    void sync_node() const;
+    // Pack faces [first, last) of u and v and start sending them
+    void start_faces(int first, int last, T *u, T *v);
+    // Wait for faces [first, last) and unpack them
+    void finish_faces(int first, int last, T *u, T *v);
 
     // Return a copy of data with ghosts removed
-    std::vector<double> data_noghost(const std::vector<double> &data) const;
+    std::vector<T> data_noghost(const T *data) const;
+    // Copy data with ghosts removed into buf, x fastest
+    void data_noghost(const T *data, T *buf) const;
+    // Copy data with ghosts removed into buf, z fastest
+    void data_noghost_native(const T *data, T *buf) const;
+    // Copy data and the first planes of the next processes, see u_extended
+    void data_extended(const T *data, T *buf) const;
+    // Average data over cells of f^3 points, see u_coarse
+    void data_coarse(const T *data, int f, T *buf, bool native) const;
 
     // Check if point is included in my subdomain
     inline bool is_inside(int x, int y, int z) const
     {
-        int sx = size_x * px;
-        int sy = size_y * py;
-        int sz = size_z * pz;
+        int sx = offset_x;
+        int sy = offset_y;
+        int sz = offset_z;
 
         int ex = sx + size_x;
         int ey = sy + size_y;
@@ -96,20 +225,35 @@ protected:
     // Convert global coordinate to local index
     inline int g2i(int gx, int gy, int gz) const
     {
-        int sx = size_x * px;
-        int sy = size_y * py;
-        int sz = size_z * pz;
+        int sx = offset_x;
+        int sy = offset_y;
+        int sz = offset_z;
 
         int x = gx - sx;
         int y = gy - sy;
         int z = gz - sz;
 
-        return l2i(x + 1, y + 1, z + 1);
+        const int g = settings.ghost_width;
+        return l2i(x + g, y + g, z + g);
     }
-    // Convert local coordinate to local index
+    // Convert local coordinate (including ghost layers) to local index
     inline int l2i(int x, int y, int z) const
     {
-        return z + y * (size_z + 2) + x * (size_y + 2) * (size_z + 2);
+        return l2i(x, y, z, size_y, size_z);
+    }
+    // Same for a block of ny * nz points in y and z
+    inline int l2i(int x, int y, int z, int ny, int nz) const
+    {
+        const int g = settings.ghost_width;
+#ifdef GS_INTERLEAVED
+        // Rows are padded to whole blocks, and every block of u is followed
+        // by the block of v
+        const int B = interleave_block<T>();
+        const int row = 2 * ((nz + 2 * g + B - 1) / B * B);
+        return z / B * 2 * B + z % B + (y + x * (ny + 2 * g)) * row;
+#else
+        return z + y * (nz + 2 * g) + x * (ny + 2 * g) * (nz + 2 * g);
+#endif
     }
 };
 
@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <unordered_map>
+
+#include "isosurface.h"
+
+namespace
+{
+
+// The cube of a cell is split into six tetrahedra around its diagonal from
+// corner 0 to corner 7. Corner c is at (c >> 2, c >> 1 & 1, c & 1) from the
+// first point of the cell. Every cell is split the same way, so the faces of
+// neighboring tetrahedra match and the surface has no cracks. The corners of
+// a tetrahedron are ordered along the diagonal, so the bits of a corner are a
+// subset of the bits of the corners after it.
+const int tetrahedra[6][4] = {{0, 4, 6, 7}, {0, 4, 5, 7}, {0, 2, 6, 7},
+                              {0, 2, 3, 7}, {0, 1, 5, 7}, {0, 1, 3, 7}};
+
+// An edge from point a of the block to a + (dx, dy, dz) is identified by
+// a * 7 + (dx << 2 | dy << 1 | dz) - 1, the same in every cell sharing it
+inline uint64_t edge_key(uint64_t a, int ca, int cb)
+{
+    return a * 7 + (cb ^ ca) - 1;
+}
+
+// Point p where the surface at iso cuts an edge of f, a block of
+// n[0] * n[1] * n[2] points whose first point is at offset. The coordinate
+// of the point is found before the fraction is added, so blocks sharing an
+// edge get the same vertex.
+template <typename T>
+void edge_point(uint64_t key, const T *f, const size_t n[3],
+                const size_t offset[3], double iso, double p[3])
+{
+    const uint64_t a = key / 7;
+    const int d = key % 7 + 1;
+    const uint64_t b = a + ((d >> 2) * n[1] + (d >> 1 & 1)) * n[2] + (d & 1);
+    const double t = (iso - f[a]) / (static_cast<double>(f[b]) - f[a]);
+    p[0] = (offset[0] + a / (n[1] * n[2])) + t * (d >> 2);
+    p[1] = (offset[1] + a / n[2] % n[1]) + t * (d >> 1 & 1);
+    p[2] = (offset[2] + a % n[2]) + t * (d & 1);
+}
+
+} // end anonymous namespace
+
+template <typename T>
+Isosurface<T>::Isosurface(const Settings &settings, const GrayScott<T> &sim,
+                          adios2::IO io, MPI_Comm comm)
+    : settings(settings), comm(comm), io(io)
+{
+    field.resize((sim.size_x + 1) * (sim.size_y + 1) * (sim.size_z + 1));
+
+    var_step = io.DefineVariable<int>("step");
+    // The number of vertices and triangles changes every step, the shape
+    // and selection are set before every Put
+    const size_t n = settings.isosurface_values.size();
+    surfaces.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        const std::string name = "iso" + std::to_string(i);
+        surfaces[i].iso = settings.isosurface_values[i];
+        surfaces[i].var_vertices = io.DefineVariable<T>(
+            name + "/vertices", {1, 3}, {0, 0}, {1, 3});
+        surfaces[i].var_triangles = io.DefineVariable<uint64_t>(
+            name + "/triangles", {1, 3}, {0, 0}, {1, 3});
+    }
+
+    io.DefineAttribute<double>("iso_values",
+                               settings.isosurface_values.data(), n);
+    io.DefineAttribute<std::string>("field", settings.isosurface_field);
+}
+
+template <typename T>
+void Isosurface<T>::open(const std::string &fname)
+{
+    writer = io.Open(fname, adios2::Mode::Write);
+}
+
+template <typename T>
+void Isosurface<T>::write(int step, const GrayScott<T> &sim)
+{
+    if (settings.isosurface_field == "U") {
+        sim.u_extended(field.data());
+    } else {
+        sim.v_extended(field.data());
+    }
+
+    const size_t n = surfaces.size();
+    std::vector<uint64_t> counts(2 * n), offsets(2 * n, 0), totals(2 * n);
+    for (size_t i = 0; i < n; i++) {
+        extract(surfaces[i], sim);
+        counts[2 * i] = surfaces[i].vertices.size() / 3;
+        counts[2 * i + 1] = surfaces[i].triangles.size() / 3;
+    }
+
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Exscan(counts.data(), offsets.data(), 2 * n, MPI_UINT64_T, MPI_SUM,
+               comm);
+    if (rank == 0) {
+        std::fill(offsets.begin(), offsets.end(), 0);
+    }
+    MPI_Allreduce(counts.data(), totals.data(), 2 * n, MPI_UINT64_T, MPI_SUM,
+                  comm);
+
+    this->step = step;
+    triangles = 0;
+
+    writer.BeginStep();
+    if (rank == 0) {
+        writer.Put<int>(var_step, &this->step);
+    }
+    for (size_t i = 0; i < n; i++) {
+        Surface &s = surfaces[i];
+        for (uint64_t &v : s.triangles) {
+            v += offsets[2 * i];
+        }
+        triangles += totals[2 * i + 1];
+
+        s.var_vertices.SetShape({totals[2 * i], 3});
+        s.var_vertices.SetSelection({{offsets[2 * i], 0}, {counts[2 * i], 3}});
+        s.var_triangles.SetShape({totals[2 * i + 1], 3});
+        s.var_triangles.SetSelection(
+            {{offsets[2 * i + 1], 0}, {counts[2 * i + 1], 3}});
+        if (counts[2 * i] > 0) {
+            writer.Put<T>(s.var_vertices, s.vertices.data());
+            writer.Put<uint64_t>(s.var_triangles, s.triangles.data());
+        }
+    }
+    writer.EndStep();
+}
+
+template <typename T>
+void Isosurface<T>::close()
+{
+    writer.Close();
+}
+
+template <typename T>
+void Isosurface<T>::extract(Surface &s, const GrayScott<T> &sim)
+{
+    const size_t n[3] = {sim.size_x + 1, sim.size_y + 1, sim.size_z + 1};
+    const size_t offset[3] = {sim.offset_x, sim.offset_y, sim.offset_z};
+    // Cells that reach past the last point of the grid would wrap around
+    const int cx = sim.offset_x + sim.size_x < size_t(settings.L)
+                       ? sim.size_x
+                       : sim.size_x - 1;
+    const int cy = sim.offset_y + sim.size_y < size_t(settings.L)
+                       ? sim.size_y
+                       : sim.size_y - 1;
+    const int cz = sim.offset_z + sim.size_z < size_t(settings.L)
+                       ? sim.size_z
+                       : sim.size_z - 1;
+    const T *f = field.data();
+    const double iso = s.iso;
+
+    uint64_t corner_offset[8];
+    for (int c = 0; c < 8; c++) {
+        corner_offset[c] = ((c >> 2) * n[1] + (c >> 1 & 1)) * n[2] + (c & 1);
+    }
+
+    // Find the cut edges of every triangle, one plane of cells per thread
+    plane_edges.resize(std::max(cx, 0));
+#pragma omp parallel for schedule(dynamic)
+    for (int x = 0; x < cx; x++) {
+        std::vector<uint64_t> &edges = plane_edges[x];
+        edges.clear();
+        for (int y = 0; y < cy; y++) {
+            for (int z = 0; z < cz; z++) {
+                const uint64_t a = (x * n[1] + y) * n[2] + z;
+                int mask = 0;
+                for (int c = 0; c < 8; c++) {
+                    mask |= (f[a + corner_offset[c]] > iso) << c;
+                }
+                if (mask == 0 || mask == 255) {
+                    continue;
+                }
+
+                for (const int *t : tetrahedra) {
+                    int in[4], out[4], nin = 0, nout = 0;
+                    for (int i = 0; i < 4; i++) {
+                        if (mask >> t[i] & 1) {
+                            in[nin++] = i;
+                        } else {
+                            out[nout++] = i;
+                        }
+                    }
+                    if (nin == 0 || nout == 0) {
+                        continue;
+                    }
+
+                    // Corners i < j of the tetrahedron
+                    auto edge = [&](int i, int j) {
+                        if (i > j) {
+                            std::swap(i, j);
+                        }
+                        return edge_key(a + corner_offset[t[i]], t[i], t[j]);
+                    };
+                    uint64_t tri[2][3];
+                    int ntri = 1;
+                    if (nin == 1 || nout == 1) {
+                        const int lone = nin == 1 ? in[0] : out[0];
+                        const int *rest = nin == 1 ? out : in;
+                        for (int k = 0; k < 3; k++) {
+                            tri[0][k] = edge(lone, rest[k]);
+                        }
+                    } else {
+                        // The cut is a quad through the edges in[0]-out[0],
+                        // in[0]-out[1], in[1]-out[1] and in[1]-out[0]
+                        const uint64_t q[4] = {
+                            edge(in[0], out[0]), edge(in[0], out[1]),
+                            edge(in[1], out[1]), edge(in[1], out[0])};
+                        tri[0][0] = q[0];
+                        tri[0][1] = q[1];
+                        tri[0][2] = q[2];
+                        tri[1][0] = q[0];
+                        tri[1][1] = q[2];
+                        tri[1][2] = q[3];
+                        ntri = 2;
+                    }
+
+                    // Point the normals from high to low values
+                    double dir[3] = {0.0, 0.0, 0.0};
+                    for (int i = 0; i < 4; i++) {
+                        const double w =
+                            (mask >> t[i] & 1) ? -1.0 / nin : 1.0 / nout;
+                        dir[0] += w * (t[i] >> 2);
+                        dir[1] += w * (t[i] >> 1 & 1);
+                        dir[2] += w * (t[i] & 1);
+                    }
+                    for (int k = 0; k < ntri; k++) {
+                        double p[3][3];
+                        for (int v = 0; v < 3; v++) {
+                            edge_point(tri[k][v], f, n, offset, iso, p[v]);
+                        }
+                        const double e1[3] = {p[1][0] - p[0][0],
+                                              p[1][1] - p[0][1],
+                                              p[1][2] - p[0][2]};
+                        const double e2[3] = {p[2][0] - p[0][0],
+                                              p[2][1] - p[0][1],
+                                              p[2][2] - p[0][2]};
+                        const double dot =
+                            (e1[1] * e2[2] - e1[2] * e2[1]) * dir[0] +
+                            (e1[2] * e2[0] - e1[0] * e2[2]) * dir[1] +
+                            (e1[0] * e2[1] - e1[1] * e2[0]) * dir[2];
+                        if (dot < 0) {
+                            std::swap(tri[k][1], tri[k][2]);
+                        }
+                        edges.insert(edges.end(), tri[k], tri[k] + 3);
+                    }
+                }
+            }
+        }
+    }
+
+    // Number the vertices in the order they are first used, which does not
+    // depend on the number of threads
+    std::unordered_map<uint64_t, uint64_t> index;
+    s.vertices.clear();
+    s.triangles.clear();
+    for (int x = 0; x < cx; x++) {
+        for (uint64_t key : plane_edges[x]) {
+            auto it = index.emplace(key, index.size());
+            if (it.second) {
+                double p[3];
+                edge_point(key, f, n, offset, iso, p);
+                s.vertices.insert(s.vertices.end(), p, p + 3);
+            }
+            s.triangles.push_back(it.first->second);
+        }
+    }
+}
+
+template class Isosurface<double>;
+template class Isosurface<float>;
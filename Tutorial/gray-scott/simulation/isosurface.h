@@ -0,0 +1,63 @@
+#ifndef __ISOSURFACE_H__
+#define __ISOSURFACE_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <adios2.h>
+#include <mpi.h>
+
+#include "gray-scott.h"
+#include "settings.h"
+
+// Triangle meshes of the isosurfaces of U or V at settings.isosurface_values.
+// Every process extracts the surfaces from the cells of its block, including
+// the cells that reach into the next process, and the meshes are written as
+// one global vertex array and one triangle array per iso-value.
+template <typename T>
+class Isosurface
+{
+public:
+    Isosurface(const Settings &settings, const GrayScott<T> &sim,
+               adios2::IO io, MPI_Comm comm);
+    void open(const std::string &fname);
+    // Extract and write the surfaces of sim. Must be called by all
+    // processes.
+    void write(int step, const GrayScott<T> &sim);
+    void close();
+
+    // Number of triangles of all surfaces of the last write
+    uint64_t triangles = 0;
+
+protected:
+    Settings settings;
+    MPI_Comm comm;
+    adios2::IO io;
+    adios2::Engine writer;
+    adios2::Variable<int> var_step;
+
+    struct Surface
+    {
+        double iso;
+        // Vertices {x, y, z} in global grid coordinates
+        adios2::Variable<T> var_vertices;
+        // Global indices of the three vertices of every triangle
+        adios2::Variable<uint64_t> var_triangles;
+        std::vector<T> vertices;
+        std::vector<uint64_t> triangles;
+    };
+    std::vector<Surface> surfaces;
+
+    // U or V of the block and the first planes of the next processes
+    std::vector<T> field;
+    // Edges cut by the triangles of every plane of cells along x
+    std::vector<std::vector<uint64_t>> plane_edges;
+    // Kept until EndStep
+    int step;
+
+    // Extract the mesh of s from field
+    void extract(Surface &s, const GrayScott<T> &sim);
+};
+
+#endif
@@ -0,0 +1,289 @@
+// Fused Gray-Scott update kernels. Each kernel updates u and v for one z-row
+// in a single pass, so the inner loop is free of index arithmetic and can be
+// vectorized, including the generation of the noise. The rows are either
+// contiguous, or u and v are interleaved in blocks along the row.
+// The same source is compiled for several instruction sets and the best one
+// is picked at runtime. All variants perform the same floating point
+// operations in the same order (this file must be built without FMA
+// contraction), so their results are bitwise identical. Kernels exist for
+// double and float fields.
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "kernel.h"
+#include "philox.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GS_KERNEL_X86
+#endif
+
+#if defined(__GNUC__)
+#define GS_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define GS_ALWAYS_INLINE inline
+#endif
+
+namespace
+{
+
+template <typename T, bool Noise>
+GS_ALWAYS_INLINE void
+calc_row_impl(const T *__restrict u, const T *__restrict v,
+              T *__restrict u2, T *__restrict v2, size_t n,
+              ptrdiff_t sx, ptrdiff_t sy, const KernelParams<T> &p,
+              const NoiseCounter &c)
+{
+    const T Du = p.Du;
+    const T Dv = p.Dv;
+    const T F = p.F;
+    const T Fk = p.Fk;
+    const T dt = p.dt;
+    const T noise = p.noise;
+    const uint32_t k0 = p.seed[0], k1 = p.seed[1];
+    const uint32_t cx = c.x, cy = c.y, cz = c.z, ct = c.step;
+
+    const T *__restrict uxm = u - sx;
+    const T *__restrict uxp = u + sx;
+    const T *__restrict uym = u - sy;
+    const T *__restrict uyp = u + sy;
+    const T *__restrict vxm = v - sx;
+    const T *__restrict vxp = v + sx;
+    const T *__restrict vym = v - sy;
+    const T *__restrict vyp = v + sy;
+
+    for (size_t i = 0; i < n; i++) {
+        const T tu = u[i];
+        const T tv = v[i];
+
+        T lu = 0;
+        lu += uxm[i];
+        lu += uxp[i];
+        lu += uym[i];
+        lu += uyp[i];
+        lu += u[i - 1];
+        lu += u[i + 1];
+        lu += T(-6.0) * tu;
+
+        T lv = 0;
+        lv += vxm[i];
+        lv += vxp[i];
+        lv += vym[i];
+        lv += vyp[i];
+        lv += v[i - 1];
+        lv += v[i + 1];
+        lv += T(-6.0) * tv;
+
+        T du = Du * (lu / T(6.0));
+        T dv = Dv * (lv / T(6.0));
+        du += -tu * tv * tv + F * (T(1.0) - tu);
+        dv += tu * tv * tv - Fk * tv;
+        if (Noise) {
+            const uint32_t z = cz + uint32_t(i);
+            du += noise * T(philox_uniform(cx, cy, z, ct, k0, k1));
+        }
+        u2[i] = tu + du * dt;
+        v2[i] = tv + dv * dt;
+    }
+}
+
+// Update lanes [j0, j1) of one block of the interleaved layout. The pointers
+// point at the u block (v block for v), the z neighbors of the first and last
+// lane are in the previous and next block.
+template <typename T, bool Noise, int B>
+GS_ALWAYS_INLINE void
+calc_block_impl(const T *__restrict u, const T *__restrict v,
+                T *__restrict u2, T *__restrict v2, int j0, int j1,
+                ptrdiff_t sx, ptrdiff_t sy, const KernelParams<T> &p,
+                const NoiseCounter &c)
+{
+    const T Du = p.Du;
+    const T Dv = p.Dv;
+    const T F = p.F;
+    const T Fk = p.Fk;
+    const T dt = p.dt;
+    const T noise = p.noise;
+    const uint32_t k0 = p.seed[0], k1 = p.seed[1];
+    const uint32_t cx = c.x, cy = c.y, cz = c.z, ct = c.step;
+
+    // z neighbors of all lanes, so that the lane loop has no branches
+    T uzm[B], uzp[B], vzm[B], vzp[B];
+    uzm[0] = u[-B - 1];
+    vzm[0] = v[-B - 1];
+    for (int j = 1; j < B; j++) {
+        uzm[j] = u[j - 1];
+        vzm[j] = v[j - 1];
+    }
+    for (int j = 0; j < B - 1; j++) {
+        uzp[j] = u[j + 1];
+        vzp[j] = v[j + 1];
+    }
+    uzp[B - 1] = u[2 * B];
+    vzp[B - 1] = v[2 * B];
+
+    for (int j = j0; j < j1; j++) {
+        const T tu = u[j];
+        const T tv = v[j];
+
+        T lu = 0;
+        lu += u[j - sx];
+        lu += u[j + sx];
+        lu += u[j - sy];
+        lu += u[j + sy];
+        lu += uzm[j];
+        lu += uzp[j];
+        lu += T(-6.0) * tu;
+
+        T lv = 0;
+        lv += v[j - sx];
+        lv += v[j + sx];
+        lv += v[j - sy];
+        lv += v[j + sy];
+        lv += vzm[j];
+        lv += vzp[j];
+        lv += T(-6.0) * tv;
+
+        T du = Du * (lu / T(6.0));
+        T dv = Dv * (lv / T(6.0));
+        du += -tu * tv * tv + F * (T(1.0) - tu);
+        dv += tu * tv * tv - Fk * tv;
+        if (Noise) {
+            const uint32_t z = cz + uint32_t(j - j0);
+            du += noise * T(philox_uniform(cx, cy, z, ct, k0, k1));
+        }
+        u2[j] = tu + du * dt;
+        v2[j] = tv + dv * dt;
+    }
+}
+
+template <typename T, bool Noise, int B>
+GS_ALWAYS_INLINE void calc_row_blocks(const T *u, const T *v,
+                                      T *u2, T *v2, size_t z,
+                                      size_t n, ptrdiff_t sx, ptrdiff_t sy,
+                                      const KernelParams<T> &p, NoiseCounter c)
+{
+    const size_t end = z + n;
+    while (z < end) {
+        const size_t o = z / B * 2 * B;
+        const int j0 = z % B;
+        const int j1 = std::min<size_t>(B, j0 + end - z);
+        if (j0 == 0 && j1 == B) {
+            // Full block, the lane loop has a constant trip count
+            calc_block_impl<T, Noise, B>(u + o, v + o, u2 + o, v2 + o, 0, B, sx,
+                                      sy, p, c);
+        } else {
+            calc_block_impl<T, Noise, B>(u + o, v + o, u2 + o, v2 + o, j0, j1,
+                                      sx, sy, p, c);
+        }
+        c.z += j1 - j0;
+        z += j1 - j0;
+    }
+}
+
+// B = 0 selects separate arrays, otherwise u and v are interleaved in blocks
+// of B points
+template <typename T, int B>
+GS_ALWAYS_INLINE void calc_row_any(const T *u, const T *v,
+                                   T *u2, T *v2, size_t z, size_t n,
+                                   ptrdiff_t sx, ptrdiff_t sy,
+                                   const KernelParams<T> &p, const NoiseCounter &c)
+{
+    if (B == 0) {
+        if (p.noise != 0.0) {
+            calc_row_impl<T, true>(u + z, v + z, u2 + z, v2 + z, n, sx, sy, p, c);
+        } else {
+            calc_row_impl<T, false>(u + z, v + z, u2 + z, v2 + z, n, sx, sy, p,
+                                 c);
+        }
+    } else {
+        if (p.noise != 0.0) {
+            calc_row_blocks<T, true, B>(u, v, u2, v2, z, n, sx, sy, p, c);
+        } else {
+            calc_row_blocks<T, false, B>(u, v, u2, v2, z, n, sx, sy, p, c);
+        }
+    }
+}
+
+template <typename T, int B>
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("no-tree-vectorize")))
+#endif
+void calc_row_scalar(const T *u, const T *v, T *u2, T *v2,
+                     size_t z, size_t n, ptrdiff_t sx, ptrdiff_t sy,
+                     const KernelParams<T> &p, const NoiseCounter &c)
+{
+    calc_row_any<T, B>(u, v, u2, v2, z, n, sx, sy, p, c);
+}
+
+#ifdef GS_KERNEL_X86
+template <typename T, int B>
+__attribute__((target("sse2"))) void
+calc_row_sse2(const T *u, const T *v, T *u2, T *v2,
+              size_t z, size_t n, ptrdiff_t sx, ptrdiff_t sy,
+              const KernelParams<T> &p, const NoiseCounter &c)
+{
+    calc_row_any<T, B>(u, v, u2, v2, z, n, sx, sy, p, c);
+}
+
+template <typename T, int B>
+__attribute__((target("avx2"))) void
+calc_row_avx2(const T *u, const T *v, T *u2, T *v2,
+              size_t z, size_t n, ptrdiff_t sx, ptrdiff_t sy,
+              const KernelParams<T> &p, const NoiseCounter &c)
+{
+    calc_row_any<T, B>(u, v, u2, v2, z, n, sx, sy, p, c);
+}
+
+template <typename T, int B>
+__attribute__((target("avx512f"))) void
+calc_row_avx512(const T *u, const T *v, T *u2, T *v2,
+                size_t z, size_t n, ptrdiff_t sx, ptrdiff_t sy,
+                const KernelParams<T> &p, const NoiseCounter &c)
+{
+    calc_row_any<T, B>(u, v, u2, v2, z, n, sx, sy, p, c);
+}
+#endif
+
+bool cpu_supports(const std::string &isa)
+{
+#ifdef GS_KERNEL_X86
+    __builtin_cpu_init();
+    if (isa == "sse2") return __builtin_cpu_supports("sse2");
+    if (isa == "avx2") return __builtin_cpu_supports("avx2");
+    if (isa == "avx512") return __builtin_cpu_supports("avx512f");
+#endif
+    return isa == "scalar";
+}
+
+} // end anonymous namespace
+
+template <typename T>
+Kernel<T> select_kernel(const std::string &name)
+{
+    constexpr int B = interleave_block<T>();
+    static const Kernel<T> kernels[] = {
+#ifdef GS_KERNEL_X86
+        {"avx512", calc_row_avx512<T, 0>, calc_row_avx512<T, B>},
+        {"avx2", calc_row_avx2<T, 0>, calc_row_avx2<T, B>},
+        {"sse2", calc_row_sse2<T, 0>, calc_row_sse2<T, B>},
+#endif
+        {"scalar", calc_row_scalar<T, 0>, calc_row_scalar<T, B>},
+    };
+
+    for (const Kernel<T> &k : kernels) {
+        if (name == "auto" && cpu_supports(k.name)) return k;
+        if (name == k.name) {
+            if (!cpu_supports(k.name)) {
+                throw std::invalid_argument("Kernel " + name +
+                                            " is not supported by this CPU");
+            }
+            return k;
+        }
+    }
+
+    throw std::invalid_argument("Unknown kernel " + name);
+}
+
+template Kernel<double> select_kernel<double>(const std::string &name);
+template Kernel<float> select_kernel<float>(const std::string &name);
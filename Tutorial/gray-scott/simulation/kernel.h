@@ -0,0 +1,61 @@
+#ifndef __KERNEL_H__
+#define __KERNEL_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Coefficients of the Gray-Scott update, hoisted out of the stencil loop
+template <typename T>
+struct KernelParams
+{
+    T Du, Dv;
+    T F;
+    // F + k
+    T Fk;
+    T dt;
+    T noise;
+    // Key of the noise generator
+    uint32_t seed[2];
+};
+
+// Counter of the noise generator for the first point of a row: its global
+// coordinate and the timestep. The z counter advances along the row.
+struct NoiseCounter
+{
+    uint32_t x, y, z;
+    uint32_t step;
+};
+
+// Number of z points per block of the interleaved layout, where a block of u
+// is followed by the same points of v: u[0..B) v[0..B) u[B..2B) v[B..2B) ...
+// One block is a 64 byte cache line and an AVX-512 register.
+template <typename T>
+constexpr int interleave_block()
+{
+    return 64 / sizeof(T);
+}
+
+template <typename T>
+struct Kernel
+{
+    // Update the points [z, z + n) of one z-row of u and v. The pointers
+    // point at local z = 0 of the row, sx and sy are the index distances to
+    // the x and y neighbors.
+    typedef void (*calc_row_t)(const T *u, const T *v, T *u2, T *v2, size_t z,
+                               size_t n, ptrdiff_t sx, ptrdiff_t sy,
+                               const KernelParams<T> &p, const NoiseCounter &c);
+
+    const char *name;
+    // Kernel for u and v in separate arrays
+    calc_row_t calc_row;
+    // Kernel for u and v interleaved in blocks of interleave_block points
+    calc_row_t calc_row_interleaved;
+};
+
+// Return the row kernel for the given instruction set ("scalar", "sse2",
+// "avx2", "avx512"). "auto" picks the widest one supported by this CPU.
+template <typename T>
+Kernel<T> select_kernel(const std::string &name);
+
+#endif
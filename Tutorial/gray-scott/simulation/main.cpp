@@ -1,10 +1,20 @@
+#include <algorithm>
 #include <iostream>
+#include <memory>
 #include <mpi.h>
 #include <vector>
 
 #include <adios2.h>
 
+#include "checkpoint.h"
+#include "delta_output.h"
+#include "ensemble.h"
 #include "gray-scott.h"
+#include "isosurface.h"
+#include "output_policy.h"
+#include "perf.h"
+#include "stats.h"
+#include "writer.h"
 
 void print_io_settings(const adios2::IO &io)
 {
@@ -23,21 +33,293 @@ void print_settings(const Settings &s)
     std::cout << "Du:               " << s.Du << std::endl;
     std::cout << "Dv:               " << s.Dv << std::endl;
     std::cout << "noise:            " << s.noise << std::endl;
+    std::cout << "seed:             " << s.seed << std::endl;
     std::cout << "output:           " << s.output << std::endl;
     std::cout << "adios_config:     " << s.adios_config << std::endl;
+    std::cout << "output_order:     " << s.output_order << std::endl;
+    std::cout << "output_buffers:   " << s.output_buffers << std::endl;
+    std::cout << "output_change:    " << s.output_change << std::endl;
+    std::cout << "output_norm:      " << s.output_norm << std::endl;
+    std::cout << "output_max_gap:   " << s.output_max_gap << std::endl;
+    std::cout << "pyramid_levels:   " << s.pyramid_levels << std::endl;
+    std::cout << "output_volume:    " << s.output_volume << std::endl;
+    std::cout << "isosurfaces:      " << s.isosurface_values.size() << " of "
+              << s.isosurface_field << std::endl;
+    std::cout << "delta_keyframe:   " << s.delta_keyframe << std::endl;
+    std::cout << "delta_error:      " << s.delta_error << std::endl;
+    std::cout << "kernel:           " << s.kernel << std::endl;
+    std::cout << "checkpoint:       " << s.checkpoint << std::endl;
+    std::cout << "checkpoint_freq:  " << s.checkpoint_freq << std::endl;
+    std::cout << "restart:          " << s.restart << std::endl;
+    std::cout << "perf:             " << s.perf << std::endl;
+    std::cout << "stats:            " << s.stats << std::endl;
+    std::cout << "precision:        " << s.precision << std::endl;
+    std::cout << "ghost_width:      " << s.ghost_width << std::endl;
+    std::cout << "node_aware:       " << s.node_aware << std::endl;
+    std::cout << "halo:             " << s.halo << std::endl;
+    std::cout << "halo_overlap:     " << s.halo_overlap << std::endl;
 }
 
-void print_simulator_settings(const GrayScott &s)
+template <typename T>
+void print_simulator_settings(const GrayScott<T> &s)
 {
     std::cout << "decomposition:    " << s.npx << "x" << s.npy << "x" << s.npz
               << std::endl;
     std::cout << "grid per process: " << s.size_x << "x" << s.size_y << "x"
               << s.size_z << std::endl;
+    std::cout << "halo on node:     " << s.halo_bytes_on_node / 1048576.0
+              << " MiB per exchange" << std::endl;
+    std::cout << "halo off node:    " << s.halo_bytes_off_node / 1048576.0
+              << " MiB per exchange" << std::endl;
+    std::cout << "stencil kernel:   " << s.kernel.name << std::endl;
+#ifdef GS_INTERLEAVED
+    std::cout << "field layout:     interleaved" << std::endl;
+#else
+    std::cout << "field layout:     separate" << std::endl;
+#endif
+    std::cout << "threads:          " << s.nthreads << std::endl;
+    std::cout << "cache tile:       " << s.tile_x << "x" << s.tile_y << "x"
+              << s.tile_z << std::endl;
+}
+
+// Set up and run the simulation with fields of type T
+template <typename T>
+void run(const Settings &settings, MPI_Comm comm)
+{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    GrayScott<T> sim(settings, comm);
+
+    sim.init();
+
+    adios2::ADIOS adios(settings.adios_config, comm, adios2::DebugON);
+
+    adios2::IO io = adios.DeclareIO("SimulationOutput");
+    adios2::IO io_ckpt = adios.DeclareIO("SimulationCheckpoint");
+    adios2::IO io_perf = adios.DeclareIO("PerfOutput");
+    adios2::IO io_stats = adios.DeclareIO("SimulationStats");
+    adios2::IO io_iso = adios.DeclareIO("SimulationIsosurface");
+
+    Checkpoint<T> checkpoint(settings, io_ckpt, comm);
+
+    int start = 0;
+    if (settings.restart) {
+        start = checkpoint.restore(settings.restart_input, sim);
+        if (rank == 0) {
+            std::cout << "Restarting after step " << start << " from "
+                      << settings.restart_input << std::endl;
+        }
+    }
+
+    if (rank == 0) {
+        print_io_settings(io);
+        std::cout << "========================================" << std::endl;
+        print_settings(settings);
+        print_simulator_settings(sim);
+        std::cout << "========================================" << std::endl;
+    }
+
+    Writer<T> writer(settings, sim, io);
+
+    std::unique_ptr<DeltaOutput<T>> delta;
+    if (settings.delta_keyframe > 0) {
+        delta.reset(new DeltaOutput<T>(settings, sim, io, comm));
+        writer.delta = delta.get();
+    }
+
+    if (settings.output_volume) {
+        writer.open(settings.output);
+    }
+
+    Isosurface<T> isosurface(settings, sim, io_iso, comm);
+    if (!settings.isosurface_values.empty()) {
+        isosurface.open(settings.isosurface_output);
+    }
+
+    Perf perf(io_perf, comm);
+    if (settings.perf) {
+        sim.perf = &perf;
+        writer.perf = &perf;
+        perf.open(settings.perf_output);
+    }
+
+    Stats stats(io_stats, comm);
+    if (settings.stats) {
+        stats.open(settings.stats_output);
+    }
+
+    if (settings.checkpoint) {
+        checkpoint.open(settings.checkpoint_output, sim, start);
+    }
+
+    OutputPolicy<T> policy(settings, comm);
+    int output_step = 0;
+
+    for (int i = start; i < settings.steps; i++) {
+        sim.iterate();
+
+        if (settings.stats) {
+            FieldStats u_stats, v_stats;
+            sim.stats(u_stats, v_stats);
+            stats.write(i, u_stats, v_stats);
+        }
+
+        if (policy.due(i, sim)) {
+            if (rank == 0) {
+                std::cout << "Simulation at step " << i
+                          << " writing output step     " << output_step;
+                if (settings.output_change > 0) {
+                    std::cout << " (change " << policy.change() << ")";
+                }
+                std::cout << std::endl;
+            }
+            output_step++;
+
+            if (settings.output_volume) {
+                writer.write(i, sim);
+            }
+            if (!settings.isosurface_values.empty()) {
+                isosurface.write(i, sim);
+                if (rank == 0) {
+                    std::cout << "Isosurfaces at step " << i << ": "
+                              << isosurface.triangles << " triangles"
+                              << std::endl;
+                }
+            }
+            if (settings.perf) {
+                perf.write(i);
+            }
+        }
+
+        if (settings.checkpoint && checkpoint.due(i + 1)) {
+            if (rank == 0) {
+                std::cout << "Writing checkpoint after step " << i + 1
+                          << std::endl;
+            }
+            checkpoint.write(i + 1, sim);
+        }
+    }
+
+    if (settings.output_volume) {
+        writer.close();
+    }
+    if (!settings.isosurface_values.empty()) {
+        isosurface.close();
+    }
+    if (settings.checkpoint) {
+        checkpoint.close();
+    }
+    if (settings.stats) {
+        stats.close();
+    }
+    if (settings.perf) {
+        perf.close();
+    }
+}
+
+// Run the members of settings.ensemble with fields of type T. The processes
+// are split into one group per member, or per several members if there are
+// more members than processes. A group advances its members together, so
+// every output step holds all members.
+template <typename T>
+void run_ensemble(const Settings &settings, MPI_Comm comm)
+{
+    int rank, procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &procs);
+
+    const int members = settings.ensemble.size();
+    const int groups = std::min(members, procs);
+    // Consecutive ranks, likely on the same node, form a group
+    const int group = static_cast<long>(rank) * groups / procs;
+    MPI_Comm group_comm;
+    MPI_Comm_split(comm, group, rank, &group_comm);
+
+    std::vector<std::unique_ptr<GrayScott<T>>> sims;
+    std::vector<GrayScott<T> *> group_sims;
+    std::vector<int> group_members;
+    for (int m = group; m < members; m += groups) {
+        Settings s = settings;
+        s.F = settings.ensemble[m].F;
+        s.k = settings.ensemble[m].k;
+        s.Du = settings.ensemble[m].Du;
+        s.Dv = settings.ensemble[m].Dv;
+        sims.emplace_back(new GrayScott<T>(s, group_comm));
+        sims.back()->init();
+        group_sims.push_back(sims.back().get());
+        group_members.push_back(m);
+    }
+
+    adios2::ADIOS adios(settings.adios_config, comm, adios2::DebugON);
+
+    adios2::IO io = adios.DeclareIO("SimulationOutput");
+    adios2::IO io_perf = adios.DeclareIO("PerfOutput");
+
+    if (rank == 0) {
+        print_io_settings(io);
+        std::cout << "========================================" << std::endl;
+        print_settings(settings);
+        std::cout << "ensemble:         " << members << " members in "
+                  << groups << " groups" << std::endl;
+        print_simulator_settings(*sims[0]);
+        std::cout << "========================================" << std::endl;
+    }
+
+    EnsembleWriter<T> writer(settings, group_sims, group_members, io);
+    writer.open(settings.output);
+
+    Perf perf(io_perf, comm);
+    if (settings.perf) {
+        for (GrayScott<T> *sim : group_sims) {
+            sim->perf = &perf;
+        }
+        writer.perf = &perf;
+        perf.open(settings.perf_output);
+    }
+
+    for (int i = 0; i < settings.steps; i++) {
+        for (GrayScott<T> *sim : group_sims) {
+            sim->iterate();
+        }
+
+        if (i % settings.plotgap == 0) {
+            if (rank == 0) {
+                std::cout << "Simulation at step " << i
+                          << " writing output step     " << i / settings.plotgap
+                          << std::endl;
+            }
+
+            writer.write(i);
+            if (settings.perf) {
+                perf.write(i);
+            }
+        }
+    }
+
+    writer.close();
+    if (settings.perf) {
+        perf.close();
+    }
+
+    sims.clear();
+    MPI_Comm_free(&group_comm);
 }
 
 int main(int argc, char **argv)
 {
-    MPI_Init(&argc, &argv);
+    Settings settings;
+    if (argc >= 2) {
+        settings = Settings::from_json(argv[1]);
+    }
+
+    // Only the main thread makes MPI calls, worker threads just compute. The
+    // I/O thread of the asynchronous output calls MPI inside ADIOS2 while
+    // the main thread exchanges halos.
+    const int required = settings.output_buffers > 0 ? MPI_THREAD_MULTIPLE
+                                                     : MPI_THREAD_FUNNELED;
+    int provided;
+    MPI_Init_thread(&argc, &argv, required, &provided);
     int rank, procs, wrank;
 
     MPI_Comm_rank(MPI_COMM_WORLD, &wrank);
@@ -57,74 +339,189 @@ int main(int argc, char **argv)
         MPI_Abort(MPI_COMM_WORLD, -1);
     }
 
-    Settings settings = Settings::from_json(argv[1]);
+    if (provided < MPI_THREAD_FUNNELED && settings.threads != 1) {
+        if (rank == 0) {
+            std::cerr << "Warning: MPI does not support MPI_THREAD_FUNNELED"
+                      << std::endl;
+        }
+    }
 
-    if (settings.L % procs != 0) {
+    if (provided < MPI_THREAD_MULTIPLE && settings.output_buffers > 0) {
         if (rank == 0) {
-            std::cerr << "L must be divisible by the number of processes"
+            std::cerr << "output_buffers requires MPI_THREAD_MULTIPLE"
                       << std::endl;
         }
         MPI_Abort(MPI_COMM_WORLD, -1);
     }
 
-    GrayScott sim(settings, comm);
+    if (settings.output_buffers < 0) {
+        if (rank == 0) {
+            std::cerr << "output_buffers must not be negative" << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
 
-    sim.init();
+    if (settings.checkpoint_freq < 0 ||
+        (settings.checkpoint_freq == 0 && settings.checkpoint_overhead <= 0)) {
+        if (rank == 0) {
+            std::cerr << "checkpoint_freq must be positive, or 0 with a "
+                         "positive checkpoint_overhead"
+                      << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
 
-    adios2::ADIOS adios(settings.adios_config, comm, adios2::DebugON);
+    // The checkpoint stream is created anew, it would delete the checkpoint
+    // the run restarts from
+    if (settings.restart && settings.checkpoint &&
+        settings.checkpoint_output == settings.restart_input) {
+        if (rank == 0) {
+            std::cerr << "checkpoint_output must differ from restart_input"
+                      << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
 
-    adios2::IO io = adios.DeclareIO("SimulationOutput");
+    if (settings.output_change < 0 || settings.output_max_gap < 0) {
+        if (rank == 0) {
+            std::cerr << "output_change and output_max_gap must not be "
+                         "negative"
+                      << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
 
-    if (rank == 0) {
-        print_io_settings(io);
-        std::cout << "========================================" << std::endl;
-        print_settings(settings);
-        print_simulator_settings(sim);
-        std::cout << "========================================" << std::endl;
+    if (settings.pyramid_levels < 0 ||
+        (settings.pyramid_levels > 0 &&
+         settings.L >> (settings.pyramid_levels - 1) < 2)) {
+        if (rank == 0) {
+            std::cerr << "pyramid_levels must be between 0 and log2(L)"
+                      << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+
+    for (int every : settings.pyramid_every) {
+        if (every < 1) {
+            if (rank == 0) {
+                std::cerr << "pyramid_every must be positive" << std::endl;
+            }
+            MPI_Abort(MPI_COMM_WORLD, -1);
+        }
+    }
+
+    if (settings.output_norm != "l2" && settings.output_norm != "linf") {
+        if (rank == 0) {
+            std::cerr << "output_norm must be l2 or linf" << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+
+    if (settings.delta_keyframe < 0 ||
+        (settings.delta_keyframe > 0 && settings.delta_error <= 0)) {
+        if (rank == 0) {
+            std::cerr << "delta_keyframe must not be negative and delta_error "
+                         "must be positive"
+                      << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, -1);
     }
 
-    io.DefineAttribute<double>("F", settings.F);
-    io.DefineAttribute<double>("k", settings.k);
-    io.DefineAttribute<double>("dt", settings.dt);
-    io.DefineAttribute<double>("Du", settings.Du);
-    io.DefineAttribute<double>("Dv", settings.Dv);
-    io.DefineAttribute<double>("noise", settings.noise);
+    // The I/O thread uses the ADIOS2 object of the simulation, which must
+    // not be called from two threads at once, so no other output may be
+    // written from the main thread while it runs
+    if (settings.output_buffers > 0 &&
+        (settings.delta_keyframe > 0 || settings.stats || settings.perf ||
+         settings.checkpoint || !settings.isosurface_values.empty())) {
+        if (rank == 0) {
+            std::cerr << "output_buffers does not support delta_keyframe, "
+                         "stats, perf, checkpoint and isosurface_values"
+                      << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
 
-    adios2::Variable<double> varU = io.DefineVariable<double>(
-        "U", {sim.npz * sim.size_z, sim.npy * sim.size_y, sim.npx * sim.size_x},
-        {sim.pz * sim.size_z, sim.py * sim.size_y, sim.px * sim.size_x},
-        {sim.size_z, sim.size_y, sim.size_x});
+    if (settings.isosurface_field != "U" && settings.isosurface_field != "V") {
+        if (rank == 0) {
+            std::cerr << "isosurface_field must be U or V" << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
 
-    adios2::Variable<double> varV = io.DefineVariable<double>(
-        "V", {sim.npz * sim.size_z, sim.npy * sim.size_y, sim.npx * sim.size_x},
-        {sim.pz * sim.size_z, sim.py * sim.size_y, sim.px * sim.size_x},
-        {sim.size_z, sim.size_y, sim.size_x});
+    if (settings.precision != "double" && settings.precision != "float") {
+        if (rank == 0) {
+            std::cerr << "precision must be double or float" << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
 
-    adios2::Variable<int> varStep = io.DefineVariable<int>("step");
+    if (settings.output_order != "zyx" && settings.output_order != "xyz") {
+        if (rank == 0) {
+            std::cerr << "output_order must be zyx or xyz" << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
 
-    adios2::Engine writer = io.Open(settings.output, adios2::Mode::Write);
+    if (settings.ghost_width < 1) {
+        if (rank == 0) {
+            std::cerr << "ghost_width must be at least 1" << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
 
-    for (int i = 0; i < settings.steps; i++) {
-        sim.iterate();
+    if (settings.halo != "datatype" && settings.halo != "packed" &&
+        settings.halo != "shared") {
+        if (rank == 0) {
+            std::cerr << "halo must be datatype, packed or shared"
+                      << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
 
-        if (i % settings.plotgap == 0) {
-            if (rank == 0) {
-                std::cout << "Simulation at step " << i 
-                          << " writing output step     " << i/settings.plotgap 
-                          << std::endl;
-            }
-            std::vector<double> u = sim.u_noghost();
-            std::vector<double> v = sim.v_noghost();
+#ifdef GS_INTERLEAVED
+    if (settings.halo == "datatype") {
+        if (rank == 0) {
+            std::cerr << "halo datatype is not available with the interleaved "
+                         "layout"
+                      << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+#endif
+
+    if (settings.halo_overlap && settings.ghost_width != 1) {
+        if (rank == 0) {
+            std::cerr << "halo_overlap requires ghost_width 1" << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
 
-            writer.BeginStep();
-            writer.Put<int>(varStep, &i);
-            writer.Put<double>(varU, u.data());
-            writer.Put<double>(varV, v.data());
-            writer.EndStep();
+    if (!settings.ensemble.empty() &&
+        (settings.checkpoint || settings.restart || settings.stats ||
+         settings.output_change > 0 || settings.pyramid_levels > 0 ||
+         settings.output_buffers > 0 || !settings.isosurface_values.empty() ||
+         !settings.output_volume || settings.delta_keyframe > 0)) {
+        if (rank == 0) {
+            std::cerr << "ensemble runs do not support checkpoint, restart, "
+                         "stats, output_change, pyramid_levels, "
+                         "output_buffers, isosurface_values, "
+                         "output_volume false and delta_keyframe"
+                      << std::endl;
         }
+        MPI_Abort(MPI_COMM_WORLD, -1);
     }
 
-    writer.Close();
+    if (!settings.ensemble.empty()) {
+        if (settings.precision == "double") {
+            run_ensemble<double>(settings, comm);
+        } else {
+            run_ensemble<float>(settings, comm);
+        }
+    } else if (settings.precision == "double") {
+        run<double>(settings, comm);
+    } else {
+        run<float>(settings, comm);
+    }
 
     MPI_Finalize();
 }
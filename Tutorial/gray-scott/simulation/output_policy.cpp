@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <cmath>
+
+#include "output_policy.h"
+
+template <typename T>
+OutputPolicy<T>::OutputPolicy(const Settings &settings, MPI_Comm comm)
+    : settings(settings), comm(comm), last_step(0), have_last(false),
+      last_change(0.0)
+{
+}
+
+template <typename T>
+bool OutputPolicy<T>::due(int i, const GrayScott<T> &sim)
+{
+    if (i % settings.plotgap != 0) {
+        return false;
+    }
+    if (settings.output_change <= 0) {
+        return true;
+    }
+
+    v.resize(sim.size_x * sim.size_y * sim.size_z);
+    sim.v_noghost(v.data(), true);
+
+    bool write = !have_last;
+    last_change = INFINITY;
+    if (have_last) {
+        last_change = relative_change();
+        write = last_change > settings.output_change ||
+                (settings.output_max_gap > 0 &&
+                 i - last_step >= settings.output_max_gap);
+    }
+
+    if (write) {
+        last_step = i;
+        have_last = true;
+        std::swap(v, last_v);
+    }
+    return write;
+}
+
+template <typename T>
+double OutputPolicy<T>::relative_change() const
+{
+    const size_t n = v.size();
+    const bool linf = settings.output_norm == "linf";
+
+    // Norm of the difference and of the last written V
+    double d = 0.0, r = 0.0;
+    if (linf) {
+#pragma omp parallel for schedule(static) reduction(max : d, r)
+        for (size_t k = 0; k < n; k++) {
+            const double a = v[k];
+            const double b = last_v[k];
+            d = std::max(d, std::fabs(a - b));
+            r = std::max(r, std::fabs(b));
+        }
+    } else {
+#pragma omp parallel for schedule(static) reduction(+ : d, r)
+        for (size_t k = 0; k < n; k++) {
+            const double a = v[k];
+            const double b = last_v[k];
+            d += (a - b) * (a - b);
+            r += b * b;
+        }
+    }
+
+    double norms[2] = {d, r};
+    MPI_Allreduce(MPI_IN_PLACE, norms, 2, MPI_DOUBLE, linf ? MPI_MAX : MPI_SUM,
+                  comm);
+    if (!linf) {
+        norms[0] = std::sqrt(norms[0]);
+        norms[1] = std::sqrt(norms[1]);
+    }
+
+    // A V that was zero everywhere changes by any amount
+    if (norms[1] == 0) {
+        return norms[0] > 0 ? INFINITY : 0.0;
+    }
+    return norms[0] / norms[1];
+}
+
+template class OutputPolicy<double>;
+template class OutputPolicy<float>;
@@ -0,0 +1,41 @@
+#ifndef __OUTPUT_POLICY_H__
+#define __OUTPUT_POLICY_H__
+
+#include <vector>
+
+#include <mpi.h>
+
+#include "gray-scott.h"
+#include "settings.h"
+
+// Decides at which steps the output is written. Without output_change every
+// plotgap-th step is written. With output_change the step is only written if
+// the relative change of V since the last written step exceeds output_change,
+// or if output_max_gap steps have passed since then.
+template <typename T>
+class OutputPolicy
+{
+public:
+    OutputPolicy(const Settings &settings, MPI_Comm comm);
+    // True if the output of step i of sim is to be written. Must be called
+    // by all processes.
+    bool due(int i, const GrayScott<T> &sim);
+    // Relative change of V at the last check of due, infinite before the
+    // first output
+    double change() const { return last_change; }
+
+protected:
+    Settings settings;
+    MPI_Comm comm;
+    // Step and V without ghosts, z fastest, of the last written step
+    int last_step;
+    bool have_last;
+    std::vector<T> last_v;
+    std::vector<T> v;
+    double last_change;
+
+    // Relative L2 or maximum norm of v - last_v over all processes
+    double relative_change() const;
+};
+
+#endif
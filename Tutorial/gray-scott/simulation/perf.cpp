@@ -0,0 +1,139 @@
+#include <iomanip>
+#include <iostream>
+
+#include <sys/resource.h>
+
+#include "perf.h"
+
+namespace
+{
+
+const char *phase_names[NPHASES] = {"compute", "exchange", "noghost", "put",
+                                    "endstep"};
+
+// Peak resident set size of this process in bytes
+uint64_t peak_rss()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+} // end anonymous namespace
+
+Perf::Perf(adios2::IO io, MPI_Comm comm)
+    : comm(comm), io(io)
+{
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &procs);
+
+    const std::string names[NPHASES] = {phase_names[0], phase_names[1],
+                                        phase_names[2], phase_names[3],
+                                        phase_names[4]};
+    io.DefineAttribute<std::string>("phases", names, NPHASES);
+
+    const size_t np = procs, r = rank, n = NPHASES;
+    var_step = io.DefineVariable<int>("step");
+    // One row per process
+    var_time = io.DefineVariable<double>("time", {np, n}, {r, 0}, {1, n});
+    var_bytes = io.DefineVariable<uint64_t>("bytes", {np, n}, {r, 0}, {1, n});
+    var_rss = io.DefineVariable<uint64_t>("rss", {np}, {r}, {1});
+    // Over all processes, written by rank 0
+    var_time_min = io.DefineVariable<double>("time_min", {n}, {0}, {n});
+    var_time_max = io.DefineVariable<double>("time_max", {n}, {0}, {n});
+    var_time_mean = io.DefineVariable<double>("time_mean", {n}, {0}, {n});
+}
+
+void Perf::add(Phase phase, double s, uint64_t b)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    seconds[phase] += s;
+    bytes[phase] += b;
+}
+
+void Perf::open(const std::string &fname)
+{
+    writer = io.Open(fname, adios2::Mode::Write);
+}
+
+void Perf::write(int step)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int p = 0; p < NPHASES; p++) {
+            time[p] = seconds[p];
+            step_bytes[p] = bytes[p];
+            total_seconds[p] += seconds[p];
+            total_bytes[p] += bytes[p];
+            seconds[p] = 0.0;
+            bytes[p] = 0;
+        }
+    }
+    this->step = step;
+    rss = peak_rss();
+
+    MPI_Reduce(time, time_min, NPHASES, MPI_DOUBLE, MPI_MIN, 0, comm);
+    MPI_Reduce(time, time_max, NPHASES, MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(time, time_mean, NPHASES, MPI_DOUBLE, MPI_SUM, 0, comm);
+    for (int p = 0; p < NPHASES; p++) {
+        time_mean[p] /= procs;
+    }
+
+    writer.BeginStep();
+    writer.Put<int>(var_step, &this->step);
+    writer.Put<double>(var_time, time);
+    writer.Put<uint64_t>(var_bytes, step_bytes);
+    writer.Put<uint64_t>(var_rss, &rss);
+    if (rank == 0) {
+        writer.Put<double>(var_time_min, time_min);
+        writer.Put<double>(var_time_max, time_max);
+        writer.Put<double>(var_time_mean, time_mean);
+    }
+    writer.EndStep();
+}
+
+void Perf::close()
+{
+    writer.Close();
+
+    double t[NPHASES], t_min[NPHASES], t_max[NPHASES], t_sum[NPHASES];
+    uint64_t b_sum[NPHASES];
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int p = 0; p < NPHASES; p++) {
+            t[p] = total_seconds[p] + seconds[p];
+            b_sum[p] = total_bytes[p] + bytes[p];
+        }
+    }
+    MPI_Reduce(t, t_min, NPHASES, MPI_DOUBLE, MPI_MIN, 0, comm);
+    MPI_Reduce(t, t_max, NPHASES, MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(t, t_sum, NPHASES, MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Reduce(rank == 0 ? MPI_IN_PLACE : b_sum, b_sum, NPHASES,
+               MPI_UINT64_T, MPI_SUM, 0, comm);
+    uint64_t rss_max = peak_rss();
+    MPI_Reduce(rank == 0 ? MPI_IN_PLACE : &rss_max, &rss_max, 1,
+               MPI_UINT64_T, MPI_MAX, 0, comm);
+
+    if (rank != 0) {
+        return;
+    }
+
+    std::cout << "========================================" << std::endl;
+    std::cout << "phase       min [s]     mean [s]    max [s]     GB moved"
+              << std::endl;
+    for (int p = 0; p < NPHASES; p++) {
+        std::cout << std::left << std::setw(12) << phase_names[p]
+                  << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(8) << t_min[p] << std::setw(12)
+                  << t_sum[p] / procs << std::setw(12) << t_max[p]
+                  << std::setw(13) << b_sum[p] * 1e-9 << std::endl;
+    }
+    std::cout << "peak RSS:   " << std::setprecision(1) << rss_max / 1048576.0
+              << " MiB (largest process)" << std::endl;
+    std::cout << "========================================" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+}
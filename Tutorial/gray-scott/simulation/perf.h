@@ -0,0 +1,91 @@
+#ifndef __PERF_H__
+#define __PERF_H__
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include <adios2.h>
+#include <mpi.h>
+
+// Phases of the simulation that are timed
+enum Phase
+{
+    PHASE_COMPUTE,
+    PHASE_EXCHANGE,
+    PHASE_NOGHOST,
+    PHASE_PUT,
+    PHASE_ENDSTEP,
+    NPHASES
+};
+
+// Time and bytes per phase of this process, written to a stream at every
+// output step and summarized over all processes at close
+class Perf
+{
+public:
+    Perf(adios2::IO io, MPI_Comm comm);
+    // Add seconds and bytes moved to a phase, may be called from any thread
+    void add(Phase phase, double seconds, uint64_t bytes);
+    void open(const std::string &fname);
+    // Write the counters since the last write
+    void write(int step);
+    // Close the stream and print the summary on rank 0
+    void close();
+
+protected:
+    MPI_Comm comm;
+    int rank, procs;
+    adios2::IO io;
+    adios2::Engine writer;
+    adios2::Variable<int> var_step;
+    adios2::Variable<double> var_time;
+    adios2::Variable<double> var_time_min;
+    adios2::Variable<double> var_time_max;
+    adios2::Variable<double> var_time_mean;
+    adios2::Variable<uint64_t> var_bytes;
+    adios2::Variable<uint64_t> var_rss;
+
+    std::mutex mutex;
+    // Since the last write and since the start
+    double seconds[NPHASES] = {};
+    uint64_t bytes[NPHASES] = {};
+    double total_seconds[NPHASES] = {};
+    uint64_t total_bytes[NPHASES] = {};
+
+    // Kept until EndStep
+    int step;
+    double time[NPHASES];
+    double time_min[NPHASES], time_max[NPHASES], time_mean[NPHASES];
+    uint64_t step_bytes[NPHASES];
+    uint64_t rss;
+};
+
+// Adds the time until it goes out of scope to a phase, does nothing without
+// perf
+class PhaseTimer
+{
+public:
+    PhaseTimer(Perf *perf, Phase phase, uint64_t bytes = 0)
+    : perf(perf), phase(phase), bytes(bytes)
+    {
+        if (perf) {
+            start = MPI_Wtime();
+        }
+    }
+
+    ~PhaseTimer()
+    {
+        if (perf) {
+            perf->add(phase, MPI_Wtime() - start, bytes);
+        }
+    }
+
+private:
+    Perf *perf;
+    Phase phase;
+    uint64_t bytes;
+    double start;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef __PHILOX_H__
+#define __PHILOX_H__
+
+#include <cstdint>
+#include <cstring>
+
+// Philox4x32-10 counter-based random number generator from Salmon et al.,
+// "Parallel Random Numbers: As Easy as 1, 2, 3" (SC'11). The output is a pure
+// function of the counter and the key, so the noise at a grid point can be
+// computed from its global coordinate and the timestep without any state.
+inline void philox4x32_10(uint32_t ctr[4], uint32_t k0, uint32_t k1)
+{
+    for (int round = 0; round < 10; round++) {
+        const uint64_t p0 = uint64_t(0xD2511F53) * ctr[0];
+        const uint64_t p1 = uint64_t(0xCD9E8D57) * ctr[2];
+        const uint32_t hi0 = uint32_t(p0 >> 32), lo0 = uint32_t(p0);
+        const uint32_t hi1 = uint32_t(p1 >> 32), lo1 = uint32_t(p1);
+
+        ctr[0] = hi1 ^ ctr[1] ^ k0;
+        ctr[1] = lo1;
+        ctr[2] = hi0 ^ ctr[3] ^ k1;
+        ctr[3] = lo0;
+
+        k0 += 0x9E3779B9;
+        k1 += 0xBB67AE85;
+    }
+}
+
+// Uniform random number in [-1, 1) for global point (x, y, z) at timestep t
+inline double philox_uniform(uint32_t x, uint32_t y, uint32_t z, uint32_t t,
+                             uint32_t k0, uint32_t k1)
+{
+    uint32_t ctr[4] = {z, y, x, t};
+    philox4x32_10(ctr, k0, k1);
+
+    // Use 52 random bits as the mantissa of a double in [2, 4)
+    const uint64_t bits = 0x4000000000000000ULL |
+                          (uint64_t(ctr[0]) << 20) | (ctr[1] >> 12);
+    double d;
+    std::memcpy(&d, &bits, sizeof(d));
+
+    return d - 3.0;
+}
+
+#endif
@@ -3,6 +3,11 @@
 #include "json.hpp"
 #include "settings.h"
 
+void to_json(nlohmann::json &j, const EnsembleMember &m)
+{
+    j = nlohmann::json{{"F", m.F}, {"k", m.k}, {"Du", m.Du}, {"Dv", m.Dv}};
+}
+
 void to_json(nlohmann::json &j, const Settings &s)
 {
     j = nlohmann::json{{"L", s.L},
@@ -14,8 +19,43 @@ void to_json(nlohmann::json &j, const Settings &s)
                        {"Du", s.Du},
                        {"Dv", s.Dv},
                        {"noise", s.noise},
+                       {"seed", s.seed},
                        {"output", s.output},
-                       {"adios_config", s.adios_config}};
+                       {"adios_config", s.adios_config},
+                       {"output_order", s.output_order},
+                       {"output_buffers", s.output_buffers},
+                       {"output_change", s.output_change},
+                       {"output_norm", s.output_norm},
+                       {"output_max_gap", s.output_max_gap},
+                       {"pyramid_levels", s.pyramid_levels},
+                       {"pyramid_every", s.pyramid_every},
+                       {"output_volume", s.output_volume},
+                       {"isosurface_values", s.isosurface_values},
+                       {"isosurface_field", s.isosurface_field},
+                       {"isosurface_output", s.isosurface_output},
+                       {"delta_keyframe", s.delta_keyframe},
+                       {"delta_error", s.delta_error},
+                       {"kernel", s.kernel},
+                       {"checkpoint", s.checkpoint},
+                       {"checkpoint_freq", s.checkpoint_freq},
+                       {"checkpoint_overhead", s.checkpoint_overhead},
+                       {"checkpoint_output", s.checkpoint_output},
+                       {"perf", s.perf},
+                       {"perf_output", s.perf_output},
+                       {"stats", s.stats},
+                       {"stats_output", s.stats_output},
+                       {"restart", s.restart},
+                       {"restart_input", s.restart_input},
+                       {"precision", s.precision},
+                       {"threads", s.threads},
+                       {"ghost_width", s.ghost_width},
+                       {"node_aware", s.node_aware},
+                       {"halo", s.halo},
+                       {"halo_overlap", s.halo_overlap},
+                       {"ensemble", s.ensemble},
+                       {"tile_x", s.tile_x},
+                       {"tile_y", s.tile_y},
+                       {"tile_z", s.tile_z}};
 }
 
 void from_json(const nlohmann::json &j, Settings &s)
@@ -29,8 +69,54 @@ void from_json(const nlohmann::json &j, Settings &s)
     j.at("Du").get_to(s.Du);
     j.at("Dv").get_to(s.Dv);
     j.at("noise").get_to(s.noise);
+    s.seed = j.value("seed", s.seed);
     j.at("output").get_to(s.output);
     j.at("adios_config").get_to(s.adios_config);
+    s.output_order = j.value("output_order", s.output_order);
+    s.output_buffers = j.value("output_buffers", s.output_buffers);
+    s.output_change = j.value("output_change", s.output_change);
+    s.output_norm = j.value("output_norm", s.output_norm);
+    s.output_max_gap = j.value("output_max_gap", s.output_max_gap);
+    s.pyramid_levels = j.value("pyramid_levels", s.pyramid_levels);
+    s.pyramid_every = j.value("pyramid_every", s.pyramid_every);
+    s.output_volume = j.value("output_volume", s.output_volume);
+    s.isosurface_values = j.value("isosurface_values", s.isosurface_values);
+    s.isosurface_field = j.value("isosurface_field", s.isosurface_field);
+    s.isosurface_output = j.value("isosurface_output", s.isosurface_output);
+    s.delta_keyframe = j.value("delta_keyframe", s.delta_keyframe);
+    s.delta_error = j.value("delta_error", s.delta_error);
+    s.kernel = j.value("kernel", s.kernel);
+    s.checkpoint = j.value("checkpoint", s.checkpoint);
+    s.checkpoint_freq = j.value("checkpoint_freq", s.checkpoint_freq);
+    s.checkpoint_overhead =
+        j.value("checkpoint_overhead", s.checkpoint_overhead);
+    s.checkpoint_output = j.value("checkpoint_output", s.checkpoint_output);
+    s.perf = j.value("perf", s.perf);
+    s.perf_output = j.value("perf_output", s.perf_output);
+    s.stats = j.value("stats", s.stats);
+    s.stats_output = j.value("stats_output", s.stats_output);
+    s.restart = j.value("restart", s.restart);
+    s.restart_input = j.value("restart_input", s.restart_input);
+    s.precision = j.value("precision", s.precision);
+    s.threads = j.value("threads", s.threads);
+    s.ghost_width = j.value("ghost_width", s.ghost_width);
+    s.node_aware = j.value("node_aware", s.node_aware);
+    s.halo = j.value("halo", s.halo);
+    s.halo_overlap = j.value("halo_overlap", s.halo_overlap);
+    // Members take the parameters they do not set from the settings
+    if (j.count("ensemble")) {
+        for (const nlohmann::json &e : j.at("ensemble")) {
+            EnsembleMember m;
+            m.F = e.value("F", s.F);
+            m.k = e.value("k", s.k);
+            m.Du = e.value("Du", s.Du);
+            m.Dv = e.value("Dv", s.Dv);
+            s.ensemble.push_back(m);
+        }
+    }
+    s.tile_x = j.value("tile_x", s.tile_x);
+    s.tile_y = j.value("tile_y", s.tile_y);
+    s.tile_z = j.value("tile_z", s.tile_z);
 }
 
 Settings::Settings()
@@ -44,8 +130,45 @@ Settings::Settings()
     Du = 0.05;
     Dv = 0.1;
     noise = 0.0;
+    seed = 0;
     output = "foo.bp";
     adios_config = "adios2.xml";
+    output_order = "zyx";
+    output_buffers = 0;
+    output_change = 0.0;
+    output_norm = "l2";
+    output_max_gap = 0;
+    pyramid_levels = 0;
+    output_volume = true;
+    isosurface_field = "V";
+    isosurface_output = "isosurface.bp";
+    delta_keyframe = 0;
+    delta_error = 1e-6;
+    kernel = "auto";
+    checkpoint = false;
+    checkpoint_freq = 0;
+    checkpoint_overhead = 0.05;
+    checkpoint_output = "ckpt.bp";
+    perf = false;
+    perf_output = "perf.bp";
+    stats = false;
+    stats_output = "stats.bp";
+    restart = false;
+    restart_input = "ckpt.bp";
+    precision = "double";
+    threads = 0;
+    ghost_width = 1;
+    node_aware = true;
+#ifdef GS_INTERLEAVED
+    // The datatypes describe separate arrays
+    halo = "packed";
+#else
+    halo = "datatype";
+#endif
+    halo_overlap = false;
+    tile_x = 0;
+    tile_y = 0;
+    tile_z = 0;
 }
 
 Settings Settings::from_json(const std::string &fname)
@@ -1,7 +1,18 @@
 #ifndef __SETTINGS_H__
 #define __SETTINGS_H__
 
+#include <cstdint>
 #include <string>
+#include <vector>
+
+// Parameters of one member of an ensemble run
+struct EnsembleMember
+{
+    double F;
+    double k;
+    double Du;
+    double Dv;
+};
 
 class Settings
 {
@@ -15,8 +26,80 @@ public:
     double Du;
     double Dv;
     double noise;
+    // Key of the noise generator
+    uint64_t seed;
     std::string output;
     std::string adios_config;
+    // Order of the dimensions of U and V in the output: "zyx" (x fastest) or
+    // "xyz" (z fastest, the order of the solver, written without a copy)
+    std::string output_order;
+    // Number of output steps that may be in flight on a background thread,
+    // 0 writes synchronously
+    int output_buffers;
+    // Write a multiple of plotgap only if the relative change of V in the
+    // output_norm ("l2" or "linf") since the last output exceeds
+    // output_change, or output_max_gap steps have passed. 0 writes every
+    // plotgap steps.
+    double output_change;
+    std::string output_norm;
+    int output_max_gap;
+    // Also write U and V averaged over cells of 2^l points per axis as
+    // U/Ll and V/Ll for l = 1 .. pyramid_levels. Level l is written every
+    // pyramid_every[l - 1] output steps, every output step if not given.
+    int pyramid_levels;
+    std::vector<int> pyramid_every;
+    // Write U and V to output. false leaves only the derived outputs, such
+    // as the isosurfaces.
+    bool output_volume;
+    // Write the triangle meshes of the isosurfaces of isosurface_field ("U"
+    // or "V") at these values to isosurface_output at every output step,
+    // empty for none
+    std::vector<double> isosurface_values;
+    std::string isosurface_field;
+    std::string isosurface_output;
+    // Write U and V in full every delta_keyframe output steps and their
+    // change since the last output step, within delta_error of U and V, in
+    // between. 0 writes every output step in full.
+    int delta_keyframe;
+    double delta_error;
+    std::string kernel;
+    // Write checkpoints every checkpoint_freq steps to checkpoint_output. With
+    // checkpoint_freq 0 the interval is chosen so that checkpoints take
+    // checkpoint_overhead of the run time.
+    bool checkpoint;
+    int checkpoint_freq;
+    double checkpoint_overhead;
+    std::string checkpoint_output;
+    // Write the time and bytes moved per phase to perf_output at every
+    // output step
+    bool perf;
+    std::string perf_output;
+    // Write the global min, max, mean, variance and L2 norm of U and V to
+    // stats_output at every step
+    bool stats;
+    std::string stats_output;
+    // Continue from the last checkpoint in restart_input
+    bool restart;
+    std::string restart_input;
+    // Floating point type of the fields: "double" or "float"
+    std::string precision;
+    // Number of threads per process, 0 uses the OpenMP default
+    int threads;
+    // Number of ghost layers, also the number of steps between exchanges
+    int ghost_width;
+    // Give the processes of each node a compact box of the process grid
+    bool node_aware;
+    // Halo exchange method: "datatype", "packed" or "shared"
+    std::string halo;
+    // Overlap the halo exchange with the update of the interior
+    bool halo_overlap;
+    // Run one simulation per member with its F, k, Du and Dv in a single job,
+    // empty for a single simulation
+    std::vector<EnsembleMember> ensemble;
+    // Cache block dimensions for the update sweep, 0 selects automatically
+    int tile_x;
+    int tile_y;
+    int tile_z;
 
     Settings();
     static Settings from_json(const std::string &fname);
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <cmath>
+
+#include "stats.h"
+
+namespace
+{
+
+const char *stat_names[5] = {"min", "max", "mean", "variance", "l2"};
+
+// Merge the statistics of two parts (Chan et al.), so the variance does not
+// suffer from the cancellation of sum(x^2) - n * mean^2
+void merge(const FieldStats &a, FieldStats &b)
+{
+    const double n = a.count + b.count;
+    if (a.count == 0) {
+        return;
+    }
+    if (b.count == 0) {
+        b = a;
+        return;
+    }
+    const double delta = a.mean - b.mean;
+    b.mean += delta * a.count / n;
+    b.m2 += a.m2 + delta * delta * a.count * b.count / n;
+    b.count = n;
+    b.min = std::min(a.min, b.min);
+    b.max = std::max(a.max, b.max);
+}
+
+void merge_op_fn(void *in, void *inout, int *len, MPI_Datatype *)
+{
+    const FieldStats *a = static_cast<const FieldStats *>(in);
+    FieldStats *b = static_cast<FieldStats *>(inout);
+    for (int i = 0; i < *len; i++) {
+        merge(a[i], b[i]);
+    }
+}
+
+void values(const FieldStats &s, double out[5])
+{
+    out[0] = s.min;
+    out[1] = s.max;
+    out[2] = s.mean;
+    out[3] = s.variance();
+    out[4] = s.l2();
+}
+
+} // end anonymous namespace
+
+double FieldStats::l2() const
+{
+    return std::sqrt(m2 + count * mean * mean);
+}
+
+Stats::Stats(adios2::IO io, MPI_Comm comm) : comm(comm), io(io)
+{
+    MPI_Comm_rank(comm, &rank);
+
+    MPI_Type_contiguous(sizeof(FieldStats) / sizeof(double), MPI_DOUBLE,
+                        &stats_type);
+    MPI_Type_commit(&stats_type);
+    MPI_Op_create(merge_op_fn, 1, &merge_op);
+
+    // Global single values, written by rank 0
+    var_step = io.DefineVariable<int>("step");
+    for (int i = 0; i < 5; i++) {
+        var_u[i] = io.DefineVariable<double>(std::string("U/") + stat_names[i]);
+        var_v[i] = io.DefineVariable<double>(std::string("V/") + stat_names[i]);
+    }
+}
+
+Stats::~Stats()
+{
+    MPI_Op_free(&merge_op);
+    MPI_Type_free(&stats_type);
+}
+
+void Stats::open(const std::string &fname)
+{
+    writer = io.Open(fname, adios2::Mode::Write);
+}
+
+void Stats::write(int step, const FieldStats &u_local,
+                  const FieldStats &v_local)
+{
+    FieldStats s[2] = {u_local, v_local};
+    MPI_Allreduce(MPI_IN_PLACE, s, 2, stats_type, merge_op, comm);
+    u = s[0];
+    v = s[1];
+
+    this->step = step;
+    values(u, u_values);
+    values(v, v_values);
+
+    writer.BeginStep();
+    if (rank == 0) {
+        writer.Put<int>(var_step, &this->step);
+        for (int i = 0; i < 5; i++) {
+            writer.Put<double>(var_u[i], &u_values[i]);
+            writer.Put<double>(var_v[i], &v_values[i]);
+        }
+    }
+    writer.EndStep();
+}
+
+void Stats::close() { writer.Close(); }
@@ -0,0 +1,57 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <string>
+
+#include <adios2.h>
+#include <mpi.h>
+
+// Count, mean, sum of squared deviations from the mean, min and max of a
+// field. The statistics of two parts of a field can be merged.
+struct FieldStats
+{
+    double count;
+    double mean;
+    double m2;
+    double min;
+    double max;
+
+    double variance() const { return count > 0 ? m2 / count : 0.0; }
+    // Square root of the sum of squares
+    double l2() const;
+};
+
+// Global statistics of u and v, written to a small stream at every step
+class Stats
+{
+public:
+    Stats(adios2::IO io, MPI_Comm comm);
+    ~Stats();
+    void open(const std::string &fname);
+    // Combine the statistics of all processes with one reduction and write
+    // them on rank 0
+    void write(int step, const FieldStats &u_local, const FieldStats &v_local);
+    void close();
+
+    // Global statistics of the last write, valid on all processes
+    FieldStats u, v;
+
+protected:
+    MPI_Comm comm;
+    int rank;
+    adios2::IO io;
+    adios2::Engine writer;
+    adios2::Variable<int> var_step;
+    // min, max, mean, variance and l2 of U and V
+    adios2::Variable<double> var_u[5];
+    adios2::Variable<double> var_v[5];
+
+    MPI_Datatype stats_type;
+    MPI_Op merge_op;
+
+    // Kept until EndStep
+    int step;
+    double u_values[5], v_values[5];
+};
+
+#endif
@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <cctype>
+
+#include "writer.h"
+
+template <typename T>
+Writer<T>::Writer(const Settings &settings, const GrayScott<T> &sim,
+                  adios2::IO io)
+    : settings(settings), io(io)
+{
+    io.DefineAttribute<double>("F", settings.F);
+    io.DefineAttribute<double>("k", settings.k);
+    io.DefineAttribute<double>("dt", settings.dt);
+    io.DefineAttribute<double>("Du", settings.Du);
+    io.DefineAttribute<double>("Dv", settings.Dv);
+    io.DefineAttribute<double>("noise", settings.noise);
+    io.DefineAttribute<uint64_t>("seed", settings.seed);
+
+    io.DefineAttribute<std::string>("axis_order", settings.output_order);
+
+    const size_t L = settings.L;
+    field_bytes = 2 * sizeof(T) * sim.size_x * sim.size_y * sim.size_z;
+    native = settings.output_order == "xyz";
+
+    if (native) {
+        var_u = io.DefineVariable<T>(
+            "U", {L, L, L}, {sim.offset_x, sim.offset_y, sim.offset_z},
+            {sim.size_x, sim.size_y, sim.size_z});
+        var_v = io.DefineVariable<T>(
+            "V", {L, L, L}, {sim.offset_x, sim.offset_y, sim.offset_z},
+            {sim.size_x, sim.size_y, sim.size_z});
+    } else {
+        var_u = io.DefineVariable<T>(
+            "U", {L, L, L}, {sim.offset_z, sim.offset_y, sim.offset_x},
+            {sim.size_z, sim.size_y, sim.size_x});
+        var_v = io.DefineVariable<T>(
+            "V", {L, L, L}, {sim.offset_z, sim.offset_y, sim.offset_x},
+            {sim.size_z, sim.size_y, sim.size_x});
+    }
+
+    var_step = io.DefineVariable<int>("step");
+
+    io.DefineAttribute<int>("pyramid_levels", settings.pyramid_levels);
+    for (int l = 1; l <= settings.pyramid_levels; l++) {
+        Level level;
+        level.f = 1 << l;
+        level.every = l <= static_cast<int>(settings.pyramid_every.size())
+                          ? settings.pyramid_every[l - 1]
+                          : 1;
+        const size_t n = (L + level.f - 1) / level.f;
+        size_t start[3], count[3];
+        sim.coarse_block(level.f, start, count);
+        if (!native) {
+            std::swap(start[0], start[2]);
+            std::swap(count[0], count[2]);
+        }
+        const std::string suffix = "/L" + std::to_string(l);
+        level.var_u = io.DefineVariable<T>(
+            "U" + suffix, {n, n, n}, {start[0], start[1], start[2]},
+            {count[0], count[1], count[2]});
+        level.var_v = io.DefineVariable<T>(
+            "V" + suffix, {n, n, n}, {start[0], start[1], start[2]},
+            {count[0], count[1], count[2]});
+        level.size = count[0] * count[1] * count[2];
+        levels.push_back(level);
+    }
+
+    // The BP engines let the application fill their buffer through a span,
+    // other engines get a copy that is kept until the next step
+    std::string engine = io.EngineType();
+    std::transform(engine.begin(), engine.end(), engine.begin(), ::tolower);
+    use_span = engine == "bpfile" || engine == "bp3" || engine == "bp4" ||
+               engine == "bp5" || engine == "file";
+
+    // Snapshots own their copy of the fields, so they are neither written
+    // through spans nor from the arrays of the solver
+    async = settings.output_buffers > 0;
+    if (async) {
+        use_span = false;
+        snapshots.resize(settings.output_buffers);
+        for (Snapshot &s : snapshots) {
+            s.u.resize(sim.size_x * sim.size_y * sim.size_z);
+            s.v.resize(sim.size_x * sim.size_y * sim.size_z);
+            free_snapshots.push_back(&s);
+        }
+    }
+
+    // In native order the interior of the ghosted arrays is selected
+    // directly
+    zero_copy = native && !async && sim.u_ghosted() != nullptr;
+    if (zero_copy) {
+        const size_t g = settings.ghost_width;
+        const adios2::Box<adios2::Dims> selection(
+            {g, g, g},
+            {sim.size_x + 2 * g, sim.size_y + 2 * g, sim.size_z + 2 * g});
+        var_u.SetMemorySelection(selection);
+        var_v.SetMemorySelection(selection);
+    }
+
+    if (!zero_copy && !use_span && !async) {
+        u.resize(sim.size_x * sim.size_y * sim.size_z);
+        v.resize(sim.size_x * sim.size_y * sim.size_z);
+    }
+}
+
+template <typename T>
+void Writer<T>::open(const std::string &fname)
+{
+    writer = io.Open(fname, adios2::Mode::Write);
+    if (async) {
+        io_thread = std::thread(&Writer<T>::io_loop, this);
+    }
+}
+
+template <typename T>
+void Writer<T>::write(int step, const GrayScott<T> &sim)
+{
+    if (async) {
+        std::unique_lock<std::mutex> lock(mutex);
+        // Block while all snapshots are in flight
+        cond.wait(lock, [this] { return !free_snapshots.empty(); });
+        Snapshot *s = free_snapshots.back();
+        free_snapshots.pop_back();
+        lock.unlock();
+
+        s->step = step;
+        s->output = outputs;
+        fill_levels(outputs++, sim, s->coarse);
+        {
+            PhaseTimer timer(perf, PHASE_NOGHOST, field_bytes);
+            sim.u_noghost(s->u.data(), native);
+            sim.v_noghost(s->v.data(), native);
+        }
+
+        lock.lock();
+        pending.push_back(s);
+        lock.unlock();
+        cond.notify_all();
+        return;
+    }
+
+    const bool full = !delta || delta->keyframe(outputs);
+    fill_levels(outputs, sim, coarse);
+
+    writer.BeginStep();
+    if (!full) {
+        PhaseTimer timer(perf, PHASE_NOGHOST, field_bytes);
+        writer.Put<int>(var_step, &step);
+        delta->put(writer, sim, false);
+    } else if (zero_copy) {
+        // The fields do not change before EndStep
+        PhaseTimer timer(perf, PHASE_PUT, field_bytes);
+        writer.Put<int>(var_step, &step);
+        writer.Put<T>(var_u, sim.u_ghosted());
+        writer.Put<T>(var_v, sim.v_ghosted());
+    } else if (use_span) {
+        // Fill each span before the next Put, which may move the buffer
+        {
+            PhaseTimer timer(perf, PHASE_PUT);
+            writer.Put<int>(var_step, &step);
+        }
+        typename adios2::Variable<T>::Span u_span = put_span(var_u);
+        {
+            PhaseTimer timer(perf, PHASE_NOGHOST, field_bytes / 2);
+            sim.u_noghost(u_span.data(), native);
+        }
+        typename adios2::Variable<T>::Span v_span = put_span(var_v);
+        {
+            PhaseTimer timer(perf, PHASE_NOGHOST, field_bytes / 2);
+            sim.v_noghost(v_span.data(), native);
+        }
+    } else {
+        {
+            PhaseTimer timer(perf, PHASE_NOGHOST, field_bytes);
+            sim.u_noghost(u.data(), native);
+            sim.v_noghost(v.data(), native);
+        }
+        PhaseTimer timer(perf, PHASE_PUT, field_bytes);
+        writer.Put<int>(var_step, &step);
+        writer.Put<T>(var_u, u.data());
+        writer.Put<T>(var_v, v.data());
+    }
+    if (full && delta) {
+        PhaseTimer timer(perf, PHASE_NOGHOST, field_bytes);
+        delta->put(writer, sim, true);
+    }
+    put_levels(outputs++, coarse);
+    {
+        PhaseTimer timer(perf, PHASE_ENDSTEP);
+        writer.EndStep();
+    }
+}
+
+template <typename T>
+void Writer<T>::fill_levels(int n, const GrayScott<T> &sim,
+                            std::vector<std::vector<T>> &c)
+{
+    c.resize(2 * levels.size());
+    for (size_t l = 0; l < levels.size(); l++) {
+        if (n % levels[l].every != 0) {
+            continue;
+        }
+        PhaseTimer timer(perf, PHASE_NOGHOST, field_bytes);
+        c[2 * l].resize(levels[l].size);
+        c[2 * l + 1].resize(levels[l].size);
+        sim.u_coarse(levels[l].f, c[2 * l].data(), native);
+        sim.v_coarse(levels[l].f, c[2 * l + 1].data(), native);
+    }
+}
+
+template <typename T>
+void Writer<T>::put_levels(int n, const std::vector<std::vector<T>> &c)
+{
+    for (size_t l = 0; l < levels.size(); l++) {
+        // A process may own no cells of a coarse level
+        if (n % levels[l].every != 0 || levels[l].size == 0) {
+            continue;
+        }
+        PhaseTimer timer(perf, PHASE_PUT, 2 * sizeof(T) * levels[l].size);
+        writer.Put<T>(levels[l].var_u, c[2 * l].data());
+        writer.Put<T>(levels[l].var_v, c[2 * l + 1].data());
+    }
+}
+
+template <typename T>
+typename adios2::Variable<T>::Span Writer<T>::put_span(adios2::Variable<T> var)
+{
+    // No data is moved, the span is filled in PHASE_NOGHOST
+    PhaseTimer timer(perf, PHASE_PUT);
+    return writer.Put(var);
+}
+
+template <typename T>
+void Writer<T>::write_snapshot(const Snapshot &s)
+{
+    writer.BeginStep();
+    {
+        PhaseTimer timer(perf, PHASE_PUT, field_bytes);
+        writer.Put<int>(var_step, &s.step);
+        writer.Put<T>(var_u, s.u.data());
+        writer.Put<T>(var_v, s.v.data());
+    }
+    put_levels(s.output, s.coarse);
+    PhaseTimer timer(perf, PHASE_ENDSTEP);
+    writer.EndStep();
+}
+
+template <typename T>
+void Writer<T>::io_loop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cond.wait(lock, [this] { return closing || !pending.empty(); });
+        // Drain the remaining snapshots before closing
+        if (pending.empty()) {
+            return;
+        }
+        Snapshot *s = pending.front();
+        lock.unlock();
+
+        write_snapshot(*s);
+
+        lock.lock();
+        pending.pop_front();
+        free_snapshots.push_back(s);
+        cond.notify_all();
+    }
+}
+
+template <typename T>
+void Writer<T>::close()
+{
+    if (async) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closing = true;
+        }
+        cond.notify_all();
+        io_thread.join();
+    }
+    writer.Close();
+}
+
+template class Writer<double>;
+template class Writer<float>;
@@ -0,0 +1,110 @@
+#ifndef __WRITER_H__
+#define __WRITER_H__
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <adios2.h>
+#include <mpi.h>
+
+#include "delta_output.h"
+#include "gray-scott.h"
+#include "perf.h"
+#include "settings.h"
+
+// Writes U, V and the step number of the simulation to an ADIOS2 stream.
+// With settings.output_buffers > 0 the fields are copied into a snapshot and
+// written by a background thread while the simulation continues.
+template <typename T>
+class Writer
+{
+public:
+    Writer(const Settings &settings, const GrayScott<T> &sim, adios2::IO io);
+    void open(const std::string &fname);
+    void write(int step, const GrayScott<T> &sim);
+    void close();
+
+    // Receives the time of the copies, Put and EndStep if set
+    Perf *perf = nullptr;
+    // Writes the change since the last output step instead of U and V at the
+    // output steps that are no keyframes if set
+    DeltaOutput<T> *delta = nullptr;
+
+protected:
+    Settings settings;
+    adios2::IO io;
+    adios2::Engine writer;
+    adios2::Variable<T> var_u;
+    adios2::Variable<T> var_v;
+    adios2::Variable<int> var_step;
+
+    // Write U and V with z fastest
+    bool native;
+    // Let the engine read U and V from the ghosted arrays of the solver
+    bool zero_copy;
+    // Copy U and V straight into the buffer of the engine
+    bool use_span;
+    // Copies of U and V for engines that do not support span
+    std::vector<T> u, v;
+    // Bytes of U and V without ghosts
+    uint64_t field_bytes;
+
+    // Level l of the pyramid: U and V averaged over cells of f = 2^l points
+    // per axis
+    struct Level
+    {
+        int f;
+        // Written every that many output steps
+        int every;
+        adios2::Variable<T> var_u;
+        adios2::Variable<T> var_v;
+        // Number of cells of this process
+        size_t size;
+    };
+    std::vector<Level> levels;
+    // Number of output steps so far
+    int outputs = 0;
+    // Averages of U and V of each level that is due, u then v
+    std::vector<std::vector<T>> coarse;
+    // Average U and V for the levels due at output step n into c
+    void fill_levels(int n, const GrayScott<T> &sim,
+                     std::vector<std::vector<T>> &c);
+    // Put the levels due at output step n, which stay in c until EndStep
+    void put_levels(int n, const std::vector<std::vector<T>> &c);
+
+    // Put a span of var
+    typename adios2::Variable<T>::Span put_span(adios2::Variable<T> var);
+
+    // U and V without ghosts at one output step
+    struct Snapshot
+    {
+        int step;
+        // Output step, selects the levels
+        int output;
+        std::vector<T> u, v;
+        std::vector<std::vector<T>> coarse;
+    };
+    // Write a snapshot in one output step
+    void write_snapshot(const Snapshot &s);
+    // Body of the I/O thread, writes pending snapshots until close
+    void io_loop();
+
+    // Write on the I/O thread
+    bool async;
+    std::thread io_thread;
+    std::mutex mutex;
+    // Signals a new pending snapshot, a written snapshot or close
+    std::condition_variable cond;
+    // Snapshots in order of steps, the first one is being written
+    std::deque<Snapshot *> pending;
+    // Snapshots that can be filled
+    std::vector<Snapshot *> free_snapshots;
+    std::vector<Snapshot> snapshots;
+    bool closing = false;
+};
+
+#endif
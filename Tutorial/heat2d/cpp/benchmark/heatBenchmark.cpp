@@ -0,0 +1,210 @@
+/*
+ * Distributed under the OSI-approved Apache License, Version 2.0.  See
+ * accompanying file Copyright.txt for details.
+ *
+ * heatBenchmark.cpp
+ *
+ * Measure iterate(), exchange() and data_noghost() of the heat transfer
+ * simulation over a range of local array sizes. The iteration and the copy
+ * are compared to the memory bandwidth measured with the STREAM triad on
+ * this node. Results go to stdout and, as JSON, to a file that can be
+ * compared across commits.
+ */
+#include <mpi.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../simulation/HeatTransfer.h"
+#include "../simulation/Settings.h"
+
+// floating point operations of one point in iterate()
+static const double flopsPerPoint = 6.0;
+
+void printUsage()
+{
+    std::cout << "Usage: heatBenchmark  [-o result.json]  [n ...]\n"
+              << "  result.json: name of the JSON output file\n"
+              << "  n:           local array size n x n per process "
+                 "(default 64 256 1024 4096)\n\n";
+}
+
+// Seconds per call of f, the slowest process counts. Runs f at least reps
+// times and for at least 0.2 s after one warm up call.
+template <class F>
+double timePerCall(F f, int reps, MPI_Comm comm)
+{
+    f();
+    MPI_Barrier(comm);
+    int n = 0;
+    int done = 0;
+    const double start = MPI_Wtime();
+    double elapsed = 0.0;
+    while (!done)
+    {
+        f();
+        ++n;
+        elapsed = MPI_Wtime() - start;
+        // all processes must run the same number of calls
+        done = n >= reps && elapsed >= 0.2;
+        MPI_Allreduce(MPI_IN_PLACE, &done, 1, MPI_INT, MPI_LAND, comm);
+    }
+    double t = elapsed / n;
+    MPI_Allreduce(MPI_IN_PLACE, &t, 1, MPI_DOUBLE, MPI_MAX, comm);
+    return t;
+}
+
+// Bandwidth of the STREAM triad a = b + s * c of all processes together in
+// bytes per second, with arrays much larger than the caches
+double streamTriad(MPI_Comm comm, int nproc)
+{
+    const size_t n = 1 << 23;
+    std::vector<double> a(n, 0.0), b(n, 1.0), c(n, 2.0);
+    const double s = 3.0;
+    double best = 1e30;
+    for (int k = 0; k < 10; ++k)
+    {
+        MPI_Barrier(comm);
+        const double start = MPI_Wtime();
+        for (size_t i = 0; i < n; ++i)
+        {
+            a[i] = b[i] + s * c[i];
+        }
+        double t = MPI_Wtime() - start;
+        MPI_Allreduce(MPI_IN_PLACE, &t, 1, MPI_DOUBLE, MPI_MAX, comm);
+        best = std::min(best, t);
+    }
+    return 3.0 * sizeof(double) * n * nproc / best;
+}
+
+int main(int argc, char *argv[])
+{
+    MPI_Init(&argc, &argv);
+    MPI_Comm comm = MPI_COMM_WORLD;
+    int rank, nproc;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nproc);
+
+    std::string output;
+    std::vector<int> sizes;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc)
+        {
+            output = argv[++i];
+        }
+        else if (arg == "-h")
+        {
+            if (!rank)
+                printUsage();
+            MPI_Finalize();
+            return 0;
+        }
+        else
+        {
+            sizes.push_back(std::atoi(argv[i]));
+        }
+    }
+    if (sizes.empty())
+    {
+        sizes = {64, 256, 1024, 4096};
+    }
+
+    int dims[2] = {0, 0};
+    MPI_Dims_create(nproc, 2, dims);
+
+    const double stream = streamTriad(comm, nproc);
+    if (!rank)
+    {
+        std::cout << "Process decomposition  : " << dims[0] << " x "
+                  << dims[1] << std::endl;
+        std::cout << "STREAM triad           : " << stream * 1e-9 << " GB/s"
+                  << std::endl;
+        std::cout << "     n  iter [ms]   GFLOP/s      GB/s  exch [ms]"
+                     "  copy [ms]  copy GB/s\n";
+    }
+
+    std::ostringstream json;
+    json << "{\n  \"processes\": " << nproc << ",\n  \"decomposition\": ["
+         << dims[0] << ", " << dims[1] << "],\n  \"stream_gbytes_per_s\": "
+         << stream * 1e-9 << ",\n  \"sizes\": [";
+
+    for (size_t k = 0; k < sizes.size(); ++k)
+    {
+        // Settings are given on the command line of the simulation
+        const std::string n = std::to_string(sizes[k]);
+        const std::string npx = std::to_string(dims[0]);
+        const std::string npy = std::to_string(dims[1]);
+        std::vector<std::string> args = {"heatBenchmark", "none", npx, npy,
+                                         n,               n,      "1", "1"};
+        std::vector<char *> cargs;
+        for (std::string &a : args)
+        {
+            cargs.push_back(&a[0]);
+        }
+        Settings settings(static_cast<int>(cargs.size()), cargs.data(), rank,
+                          nproc);
+
+        HeatTransfer ht(settings);
+        ht.init(false, comm);
+        ht.heatEdges();
+        ht.exchange(comm);
+
+        const double points = static_cast<double>(settings.ndx) * settings.ndy;
+        const double tIterate = timePerCall([&] { ht.iterate(); }, 10, comm);
+        const double tExchange =
+            timePerCall([&] { ht.exchange(comm); }, 10, comm);
+        std::vector<double> copy;
+        const double tNoghost =
+            timePerCall([&] { copy = ht.data_noghost(); }, 10, comm);
+
+        // minimum memory traffic: iterate() reads T and writes the next T,
+        // data_noghost() reads T and writes the copy
+        const double bytes = 2 * sizeof(double) * points * nproc;
+        const double gflops = flopsPerPoint * points * nproc / tIterate * 1e-9;
+        const double exchangeBytes = ht.exchangeBytes();
+
+        if (!rank)
+        {
+            std::ios_base::fmtflags flags = std::cout.flags();
+            std::cout << std::setw(6) << sizes[k] << std::fixed
+                      << std::setprecision(3) << std::setw(11)
+                      << tIterate * 1e3 << std::setw(10) << gflops
+                      << std::setw(10) << bytes / tIterate * 1e-9
+                      << std::setw(11) << tExchange * 1e3 << std::setw(11)
+                      << tNoghost * 1e3 << std::setw(11)
+                      << bytes / tNoghost * 1e-9 << "\n";
+            std::cout.flags(flags);
+        }
+
+        json << (k ? "," : "") << "\n    {\n      \"n\": " << sizes[k]
+             << ",\n      \"iterate\": {\"seconds\": " << tIterate
+             << ", \"gflops\": " << gflops
+             << ", \"gbytes_per_s\": " << bytes / tIterate * 1e-9
+             << ", \"stream_fraction\": " << bytes / tIterate / stream
+             << "},\n      \"exchange\": {\"seconds\": " << tExchange
+             << ", \"bytes\": " << exchangeBytes
+             << ", \"gbytes_per_s\": " << exchangeBytes / tExchange * 1e-9
+             << "},\n      \"noghost\": {\"seconds\": " << tNoghost
+             << ", \"gbytes_per_s\": " << bytes / tNoghost * 1e-9
+             << ", \"stream_fraction\": " << bytes / tNoghost / stream
+             << "}\n    }";
+    }
+    json << "\n  ]\n}\n";
+
+    if (!rank && !output.empty())
+    {
+        std::ofstream ofs(output);
+        ofs << json.str();
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,42 @@
+/*
+ * Distributed under the OSI-approved Apache License, Version 2.0.  See
+ * accompanying file Copyright.txt for details.
+ *
+ * AlignedAlloc.cpp
+ *
+ * Allocation of the large arrays of the simulation on huge pages
+ */
+
+#include "AlignedAlloc.h"
+
+#include <sys/mman.h>
+
+#include <cstdlib>
+#include <new>
+
+static const size_t hugePageSize = 2 * 1024 * 1024;
+
+void *alignedAlloc(size_t bytes)
+{
+    size_t alignment = 64;
+    if (bytes >= hugePageSize)
+    {
+        alignment = hugePageSize;
+        bytes = (bytes + hugePageSize - 1) & ~(hugePageSize - 1);
+    }
+    void *p;
+    if (posix_memalign(&p, alignment, bytes) != 0)
+    {
+        throw std::bad_alloc();
+    }
+#ifdef MADV_HUGEPAGE
+    // only a hint, ignored without transparent huge pages
+    if (alignment == hugePageSize)
+    {
+        madvise(p, bytes, MADV_HUGEPAGE);
+    }
+#endif
+    return p;
+}
+
+void alignedFree(void *p) { free(p); }
@@ -0,0 +1,22 @@
+/*
+ * Distributed under the OSI-approved Apache License, Version 2.0.  See
+ * accompanying file Copyright.txt for details.
+ *
+ * AlignedAlloc.h
+ *
+ * Allocation of the large arrays of the simulation on huge pages
+ */
+
+#ifndef ALIGNEDALLOC_H_
+#define ALIGNEDALLOC_H_
+
+#include <cstddef>
+
+// Allocate bytes without writing them. At least one huge page (2 MB) is
+// aligned to huge pages, padded to whole huge pages and advised to use them,
+// less is aligned to a cache line. The process or thread that writes a page
+// first decides on which NUMA node it is placed. Throws std::bad_alloc.
+void *alignedAlloc(size_t bytes);
+void alignedFree(void *p);
+
+#endif /* ALIGNEDALLOC_H_ */
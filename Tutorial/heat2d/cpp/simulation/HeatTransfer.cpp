@@ -18,28 +18,40 @@
 #include <stdexcept>
 #include <string>
 
+#include "AlignedAlloc.h"
 #include "HeatTransfer.h"
 
 HeatTransfer::HeatTransfer(const Settings &settings) : m_s{settings}
 {
+    const size_t bytes = sizeof(double) * (m_s.ndx + 2) * (m_s.ndy + 2);
     m_T1 = new double *[m_s.ndx + 2];
-    m_T1[0] = new double[(m_s.ndx + 2) * (m_s.ndy + 2)];
+    m_T1[0] = static_cast<double *>(alignedAlloc(bytes));
     m_T2 = new double *[m_s.ndx + 2];
-    m_T2[0] = new double[(m_s.ndx + 2) * (m_s.ndy + 2)];
+    m_T2[0] = static_cast<double *>(alignedAlloc(bytes));
     for (unsigned int i = 1; i < m_s.ndx + 2; i++)
     {
         m_T1[i] = m_T1[i - 1] + m_s.ndy + 2;
         m_T2[i] = m_T2[i - 1] + m_s.ndy + 2;
     }
+    // First touch by this process, row by row as in iterate(), places the
+    // pages on its NUMA node
+    for (unsigned int i = 0; i < m_s.ndx + 2; i++)
+    {
+        for (unsigned int j = 0; j < m_s.ndy + 2; j++)
+        {
+            m_T1[i][j] = 0.0;
+            m_T2[i][j] = 0.0;
+        }
+    }
     m_TCurrent = m_T1;
     m_TNext = m_T2;
 }
 
 HeatTransfer::~HeatTransfer()
 {
-    delete[] m_T1[0];
+    alignedFree(m_T1[0]);
     delete[] m_T1;
-    delete[] m_T2[0];
+    alignedFree(m_T2[0]);
     delete[] m_T2;
 }
 
@@ -258,6 +270,20 @@ void HeatTransfer::exchange(MPI_Comm comm)
     delete[] recv_x;
 }
 
+unsigned long long HeatTransfer::exchangeBytes() const
+{
+    unsigned long long n = 0;
+    if (m_s.rank_left >= 0)
+        n += m_s.ndx + 2;
+    if (m_s.rank_right >= 0)
+        n += m_s.ndx + 2;
+    if (m_s.rank_up >= 0)
+        n += m_s.ndy + 2;
+    if (m_s.rank_down >= 0)
+        n += m_s.ndy + 2;
+    return n * sizeof(double);
+}
+
 #include <cstring>
 /* Copies the internal ndx*ndy section of the ndx+2 * ndy+2 local array
  * into a separate contiguous vector and returns it.
@@ -28,6 +28,8 @@ public:
     void iterate();                 // one local calculation step
     void heatEdges();               // reset the heat values at the global edge
     void exchange(MPI_Comm comm);   // send updates to neighbors
+    // bytes sent to the neighbors by one exchange()
+    unsigned long long exchangeBytes() const;
 
     // return a single value at index i,j. 0 <= i <= ndx+2, 0 <= j <= ndy+2
     double T(int i, int j) const { return m_TCurrent[i][j]; };
@@ -12,6 +12,7 @@
 #define IO_H_
 
 #include "HeatTransfer.h"
+#include "Perf.h"
 #include "Settings.h"
 
 #include <mpi.h>
@@ -22,7 +23,9 @@ public:
     IO(const Settings &s, MPI_Comm comm);
     ~IO();
     void write(int step, const HeatTransfer &ht, const Settings &s,
-               MPI_Comm comm);
+               MPI_Comm comm, Perf &perf);
+    // write the results of perf.collect() if s.perffile is set
+    void writePerf(int step, const Settings &s, const Perf &perf);
 };
 
 #endif /* IO_H_ */
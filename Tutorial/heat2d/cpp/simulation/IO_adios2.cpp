@@ -20,6 +20,16 @@ adios2::Engine writer;
 adios2::Variable<double> varT;
 adios2::Variable<unsigned int> varGndx;
 
+adios2::Engine perfWriter;
+adios2::Variable<int> varPerfStep;
+adios2::Variable<double> varPerfTime;
+adios2::Variable<double> varPerfTimeMin;
+adios2::Variable<double> varPerfTimeMax;
+adios2::Variable<double> varPerfTimeMean;
+adios2::Variable<unsigned long long> varPerfBytes;
+adios2::Variable<unsigned long long> varPerfRSS;
+int perfStep;
+
 IO::IO(const Settings &s, MPI_Comm comm)
 {
     ad = new adios2::ADIOS(s.configfile, comm, adios2::DebugON);
@@ -63,23 +73,89 @@ IO::IO(const Settings &s, MPI_Comm comm)
     // we promise here that we don't change the variables over steps
     // (the list of variables, their dimensions, and their selections)
     io.LockDefinitions();
+
+    if (!s.perffile.empty())
+    {
+        adios2::IO perfIO = ad->DeclareIO("PerfOutput");
+
+        std::string phases[Perf::NPhases];
+        for (int p = 0; p < Perf::NPhases; ++p)
+        {
+            phases[p] = Perf::PhaseName(p);
+        }
+        perfIO.DefineAttribute<std::string>("phases", phases, Perf::NPhases);
+
+        const size_t np = s.nproc, r = s.rank, n = Perf::NPhases;
+        varPerfStep = perfIO.DefineVariable<int>("step");
+        // one row per process
+        varPerfTime =
+            perfIO.DefineVariable<double>("time", {np, n}, {r, 0}, {1, n});
+        varPerfBytes = perfIO.DefineVariable<unsigned long long>(
+            "bytes", {np, n}, {r, 0}, {1, n});
+        varPerfRSS =
+            perfIO.DefineVariable<unsigned long long>("rss", {np}, {r}, {1});
+        // over all processes, written by rank 0
+        varPerfTimeMin =
+            perfIO.DefineVariable<double>("time_min", {n}, {0}, {n});
+        varPerfTimeMax =
+            perfIO.DefineVariable<double>("time_max", {n}, {0}, {n});
+        varPerfTimeMean =
+            perfIO.DefineVariable<double>("time_mean", {n}, {0}, {n});
+
+        perfWriter = perfIO.Open(s.perffile, adios2::Mode::Write, comm);
+        perfIO.LockDefinitions();
+    }
 }
 
 IO::~IO()
 {
     writer.Close();
+    if (perfWriter)
+    {
+        perfWriter.Close();
+    }
     delete ad;
 }
 
 void IO::write(int step, const HeatTransfer &ht, const Settings &s,
-               MPI_Comm comm)
+               MPI_Comm comm, Perf &perf)
 {
+    const unsigned long long bytes = s.ndx * s.ndy * sizeof(double);
     writer.BeginStep();
     // using Put() you promise the pointer to the data will be intact
     // until the end of the output step.
     // We need to have the vector object here not to destruct here until the end
     // of function.
-    std::vector<double> v = ht.data_noghost();
-    writer.Put<double>(varT, v.data());
+    std::vector<double> v;
+    {
+        Perf::Timer timer(perf, Perf::Noghost, bytes);
+        v = ht.data_noghost();
+    }
+    {
+        Perf::Timer timer(perf, Perf::Put, bytes);
+        writer.Put<double>(varT, v.data());
+    }
+    Perf::Timer timer(perf, Perf::EndStep);
     writer.EndStep();
 }
+
+void IO::writePerf(int step, const Settings &s, const Perf &perf)
+{
+    if (!perfWriter)
+    {
+        return;
+    }
+    perfStep = step;
+    perfWriter.BeginStep();
+    perfWriter.Put<int>(varPerfStep, &perfStep);
+    perfWriter.Put<double>(varPerfTime, perf.m_Time);
+    perfWriter.Put<unsigned long long>(varPerfBytes, perf.m_Bytes);
+    perfWriter.Put<unsigned long long>(varPerfRSS, &perf.m_PeakRSS);
+    if (s.rank == 0)
+    {
+        perfWriter.Put<double>(varPerfTimeMin, perf.m_TimeMin);
+        perfWriter.Put<double>(varPerfTimeMax, perf.m_TimeMax);
+        perfWriter.Put<double>(varPerfTimeMean, perf.m_TimeMean);
+    }
+    perfWriter.EndStep();
+}
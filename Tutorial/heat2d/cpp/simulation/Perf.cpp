@@ -0,0 +1,113 @@
+/*
+ * Distributed under the OSI-approved Apache License, Version 2.0.  See
+ * accompanying file Copyright.txt for details.
+ *
+ * Perf.cpp
+ *
+ * Time and bytes moved per phase of the simulation
+ */
+
+#include "Perf.h"
+
+#include <sys/resource.h>
+
+#include <iomanip>
+#include <iostream>
+
+static unsigned long long peakRSS()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return static_cast<unsigned long long>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+const char *Perf::PhaseName(int phase)
+{
+    static const char *names[NPhases] = {"compute", "exchange", "noghost",
+                                         "put", "endstep"};
+    return names[phase];
+}
+
+void Perf::add(Phase phase, double seconds, unsigned long long bytes)
+{
+    m_Seconds[phase] += seconds;
+    m_IntervalBytes[phase] += bytes;
+}
+
+void Perf::collect(MPI_Comm comm)
+{
+    int nproc;
+    MPI_Comm_size(comm, &nproc);
+
+    for (int p = 0; p < NPhases; ++p)
+    {
+        m_Time[p] = m_Seconds[p];
+        m_Bytes[p] = m_IntervalBytes[p];
+        m_TotalSeconds[p] += m_Seconds[p];
+        m_TotalBytes[p] += m_IntervalBytes[p];
+        m_Seconds[p] = 0.0;
+        m_IntervalBytes[p] = 0;
+    }
+    m_PeakRSS = peakRSS();
+
+    MPI_Reduce(m_Time, m_TimeMin, NPhases, MPI_DOUBLE, MPI_MIN, 0, comm);
+    MPI_Reduce(m_Time, m_TimeMax, NPhases, MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(m_Time, m_TimeMean, NPhases, MPI_DOUBLE, MPI_SUM, 0, comm);
+    for (int p = 0; p < NPhases; ++p)
+    {
+        m_TimeMean[p] /= nproc;
+    }
+}
+
+void Perf::printSummary(MPI_Comm comm) const
+{
+    int rank, nproc;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nproc);
+
+    double t[NPhases], tmin[NPhases], tmax[NPhases], tsum[NPhases];
+    unsigned long long b[NPhases], bsum[NPhases];
+    for (int p = 0; p < NPhases; ++p)
+    {
+        t[p] = m_TotalSeconds[p] + m_Seconds[p];
+        b[p] = m_TotalBytes[p] + m_IntervalBytes[p];
+    }
+    unsigned long long rss = peakRSS(), rssmax;
+
+    MPI_Reduce(t, tmin, NPhases, MPI_DOUBLE, MPI_MIN, 0, comm);
+    MPI_Reduce(t, tmax, NPhases, MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(t, tsum, NPhases, MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Reduce(b, bsum, NPhases, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, comm);
+    MPI_Reduce(&rss, &rssmax, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, 0, comm);
+
+    if (rank)
+        return;
+
+    std::ios_base::fmtflags flags = std::cout.flags();
+    std::cout << "phase       min [s]     mean [s]    max [s]     GB moved\n";
+    for (int p = 0; p < NPhases; ++p)
+    {
+        std::cout << std::left << std::setw(12) << PhaseName(p) << std::right
+                  << std::fixed << std::setprecision(3) << std::setw(8)
+                  << tmin[p] << std::setw(12) << tsum[p] / nproc
+                  << std::setw(12) << tmax[p] << std::setw(13)
+                  << bsum[p] * 1e-9 << "\n";
+    }
+    std::cout << "peak RSS:   " << std::setprecision(1) << rssmax / 1048576.0
+              << " MiB (largest process)\n";
+    std::cout.flags(flags);
+}
+
+Perf::Timer::Timer(Perf &perf, Phase phase, unsigned long long bytes)
+: m_Perf(perf), m_Phase(phase), m_Bytes(bytes), m_Start(MPI_Wtime())
+{
+}
+
+Perf::Timer::~Timer()
+{
+    m_Perf.add(m_Phase, MPI_Wtime() - m_Start, m_Bytes);
+}
@@ -0,0 +1,67 @@
+/*
+ * Distributed under the OSI-approved Apache License, Version 2.0.  See
+ * accompanying file Copyright.txt for details.
+ *
+ * Perf.h
+ *
+ * Time and bytes moved per phase of the simulation
+ */
+
+#ifndef PERF_H_
+#define PERF_H_
+
+#include <mpi.h>
+
+class Perf
+{
+public:
+    enum Phase
+    {
+        Compute = 0,
+        Exchange,
+        Noghost,
+        Put,
+        EndStep,
+        NPhases
+    };
+
+    static const char *PhaseName(int phase);
+
+    // add seconds and bytes moved to a phase
+    void add(Phase phase, double seconds, unsigned long long bytes);
+    // finish the interval since the last call and compute the values below
+    void collect(MPI_Comm comm);
+    // print min, mean and max time per phase over all processes on rank 0
+    void printSummary(MPI_Comm comm) const;
+
+    // results of collect(): this process
+    double m_Time[NPhases];
+    unsigned long long m_Bytes[NPhases];
+    unsigned long long m_PeakRSS;
+    // results of collect(): over all processes, valid on rank 0
+    double m_TimeMin[NPhases];
+    double m_TimeMax[NPhases];
+    double m_TimeMean[NPhases];
+
+    // adds the time until it goes out of scope to a phase
+    class Timer
+    {
+    public:
+        Timer(Perf &perf, Phase phase, unsigned long long bytes = 0);
+        ~Timer();
+
+    private:
+        Perf &m_Perf;
+        Phase m_Phase;
+        unsigned long long m_Bytes;
+        double m_Start;
+    };
+
+private:
+    double m_Seconds[NPhases] = {};
+    unsigned long long m_IntervalBytes[NPhases] = {};
+    double m_TotalSeconds[NPhases] = {};
+    unsigned long long m_TotalBytes[NPhases] = {};
+};
+
+#endif /* PERF_H_ */
@@ -15,6 +15,7 @@
 #include <cstdlib>
 
 #include <stdexcept>
+#include <vector>
 
 static unsigned int convertToUint(std::string varName, char *arg)
 {
@@ -49,6 +50,10 @@ Settings::Settings(int argc, char *argv[], int rank, int nproc) : rank{rank}
     ndy = convertToUint("ny", argv[5]);
     steps = convertToUint("steps", argv[6]);
     iterations = convertToUint("iterations", argv[7]);
+    if (argc > 8)
+    {
+        perffile = argv[8];
+    }
 
     if (npx * npy != this->nproc)
     {
@@ -84,3 +89,98 @@ Settings::Settings(int argc, char *argv[], int rank, int nproc) : rank{rank}
     else
         rank_right = rank + npx;
 }
+
+void Settings::placeOnNodes(MPI_Comm comm)
+{
+    // the first process of a node names it
+    MPI_Comm nodeComm;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL,
+                        &nodeComm);
+    int nodeRank, nodeSize;
+    MPI_Comm_rank(nodeComm, &nodeRank);
+    MPI_Comm_size(nodeComm, &nodeSize);
+    int leader = rank;
+    MPI_Bcast(&leader, 1, MPI_INT, 0, nodeComm);
+    MPI_Comm_free(&nodeComm);
+
+    std::vector<int> leaders(nproc);
+    MPI_Allgather(&leader, 1, MPI_INT, leaders.data(), 1, MPI_INT, comm);
+
+    // number the nodes in the order of their first process
+    std::vector<int> nodeOf(nproc), index(nproc, -1), sizes;
+    for (unsigned int r = 0; r < nproc; ++r)
+    {
+        if (leaders[r] == static_cast<int>(r))
+        {
+            index[r] = sizes.size();
+            sizes.push_back(0);
+        }
+        nodeOf[r] = index[leaders[r]];
+        ++sizes[nodeOf[r]];
+    }
+    bool even = true;
+    for (int n : sizes)
+        even = even && n == nodeSize;
+
+    // block of tx * ty processes per node with the fewest ghost cells
+    // crossing nodes: every line of processes crosses a node boundary
+    // between each pair of neighboring blocks along it
+    unsigned int tx = 0, ty = 0;
+    unsigned long long best = 0;
+    for (unsigned int a = 1; even && a <= npx; ++a)
+    {
+        if (npx % a != 0 || nodeSize % a != 0)
+            continue;
+        const unsigned int b = nodeSize / a;
+        if (npy % b != 0)
+            continue;
+        const unsigned long long crossing =
+            (npx / a - 1ULL) * npy * (ndy + 2) +
+            (npy / b - 1ULL) * npx * (ndx + 2);
+        if (!tx || crossing < best)
+        {
+            tx = a;
+            ty = b;
+            best = crossing;
+        }
+    }
+
+    if (tx)
+    {
+        const unsigned int nodesX = npx / tx;
+        const unsigned int node = nodeOf[rank];
+        posx = node % nodesX * tx + nodeRank % tx;
+        posy = node / nodesX * ty + nodeRank / tx;
+        offsx = posx * ndx;
+        offsy = posy * ndy;
+    }
+
+    // rank of the process at every position
+    std::vector<int> rankAt(nproc);
+    const int position = posx + posy * npx;
+    std::vector<int> positions(nproc);
+    MPI_Allgather(&position, 1, MPI_INT, positions.data(), 1, MPI_INT, comm);
+    for (unsigned int r = 0; r < nproc; ++r)
+        rankAt[positions[r]] = r;
+
+    rank_up = posx == 0 ? -1 : rankAt[position - 1];
+    rank_down = posx == npx - 1 ? -1 : rankAt[position + 1];
+    rank_left = posy == 0 ? -1 : rankAt[position - npx];
+    rank_right = posy == npy - 1 ? -1 : rankAt[position + npx];
+
+    // the exchange sends ndx+2 values left and right, ndy+2 up and down
+    unsigned long long halo[2] = {0, 0};
+    const int neighbors[4] = {rank_left, rank_right, rank_up, rank_down};
+    for (int i = 0; i < 4; ++i)
+    {
+        if (neighbors[i] < 0)
+            continue;
+        const unsigned long long bytes =
+            (i < 2 ? ndx + 2 : ndy + 2) * sizeof(double);
+        halo[nodeOf[neighbors[i]] == nodeOf[rank] ? 0 : 1] += bytes;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, halo, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM,
+                  comm);
+    haloBytesOnNode = halo[0];
+    haloBytesOffNode = halo[1];
+}
@@ -11,6 +11,8 @@
 #ifndef SETTINGS_H_
 #define SETTINGS_H_
 
+#include <mpi.h>
+
 #include <string>
 
 class Settings
@@ -26,6 +28,7 @@ public:
     unsigned int ndy;        // Local array size in y dimension per process
     unsigned int steps;      // Number of output steps
     unsigned int iterations; // Number of computing iterations between steps
+    std::string perffile;    // Performance output stream, empty if none
 
     // calculated values from those arguments and number of processes
     unsigned int gndx; // Global array size in slow dimension
@@ -33,7 +36,7 @@ public:
     // X dim positions: rank 0, npx, 2npx... are in the same X position
     // Y dim positions: npx number of consecutive processes belong to one row
     // (npx
-    // columns)
+    // columns). placeOnNodes() may place the processes differently.
     unsigned int posx;  // Position of this process in X dimension
     unsigned int posy;  // Position of this process in Y dimension
     unsigned int offsx; // Offset of local array in X dimension on this process
@@ -48,10 +51,20 @@ public:
     int rank_up;
     int rank_down;
 
+    // bytes of one exchange of all processes that stay on a node and that
+    // cross nodes, set by placeOnNodes()
+    unsigned long long haloBytesOnNode = 0;
+    unsigned long long haloBytesOffNode = 0;
+
     /** true: std::async Write, false (default): sync */
     bool async = false;
 
     Settings(int argc, char *argv[], int rank, int nproc);
+
+    // Give the processes of each node a compact block of the process grid,
+    // so that most ghost cells are exchanged within the node. Keeps the
+    // placement above if the nodes differ in size or no block fits.
+    void placeOnNodes(MPI_Comm comm);
 };
 
 #endif /* SETTINGS_H_ */
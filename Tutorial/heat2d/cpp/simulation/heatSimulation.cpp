@@ -19,20 +19,23 @@
 
 #include "HeatTransfer.h"
 #include "IO.h"
+#include "Perf.h"
 #include "Settings.h"
 
 void printUsage()
 {
     std::cout
         << "Usage: heatSimulation   output  N  M   nx  ny   steps "
-           "iterations\n"
+           "iterations [perf]\n"
         << "  output: name of output data file/stream\n"
         << "  N:      number of processes in X dimension\n"
         << "  M:      number of processes in Y dimension\n"
         << "  nx:     local array size in X dimension per processor\n"
         << "  ny:     local array size in Y dimension per processor\n"
         << "  steps:  the total number of steps to output\n"
-        << "  iterations: one step consist of this many iterations\n\n";
+        << "  iterations: one step consist of this many iterations\n"
+        << "  perf:   name of the performance output data file/stream "
+           "(optional)\n\n";
 }
 
 int main(int argc, char *argv[])
@@ -62,10 +65,16 @@ int main(int argc, char *argv[])
     {
         double timeStart = MPI_Wtime();
         Settings settings(argc, argv, rank, nproc);
+        settings.placeOnNodes(mpiHeatTransferComm);
         if (!rank)
         {
             std::cout << "Process decomposition  : " << settings.npx << " x "
                       << settings.npy << std::endl;
+            std::cout << "Halo bytes on node     : " << settings.haloBytesOnNode
+                      << " per exchange" << std::endl;
+            std::cout << "Halo bytes off node    : "
+                      << settings.haloBytesOffNode << " per exchange"
+                      << std::endl;
             std::cout << "Array size per process : " << settings.ndx << " x "
                       << settings.ndy << std::endl;
             std::cout << "Number of output steps : " << settings.steps
@@ -85,7 +94,15 @@ int main(int argc, char *argv[])
         ht.exchange(mpiHeatTransferComm);
         // ht.printT("Heated T:", mpiHeatTransferComm);
 
-        io.write(0, ht, settings, mpiHeatTransferComm);
+        Perf perf;
+        // iterate() reads T and writes the next T
+        const unsigned long long computeBytes =
+            2 * settings.ndx * settings.ndy * sizeof(double);
+        const unsigned long long exchangeBytes = ht.exchangeBytes();
+
+        io.write(0, ht, settings, mpiHeatTransferComm, perf);
+        perf.collect(mpiHeatTransferComm);
+        io.writePerf(0, settings, perf);
 
         for (unsigned int t = 1; t < settings.steps; ++t)
         {
@@ -93,18 +110,28 @@ int main(int argc, char *argv[])
                 std::cout << "Simulation step " << t << "\n";
             for (unsigned int iter = 1; iter <= settings.iterations; ++iter)
             {
-                ht.iterate();
-                ht.exchange(mpiHeatTransferComm);
+                {
+                    Perf::Timer timer(perf, Perf::Compute, computeBytes);
+                    ht.iterate();
+                }
+                {
+                    Perf::Timer timer(perf, Perf::Exchange, exchangeBytes);
+                    ht.exchange(mpiHeatTransferComm);
+                }
+                Perf::Timer timer(perf, Perf::Compute);
                 ht.heatEdges();
             }
 
-            io.write(t, ht, settings, mpiHeatTransferComm);
+            io.write(t, ht, settings, mpiHeatTransferComm, perf);
+            perf.collect(mpiHeatTransferComm);
+            io.writePerf(t, settings, perf);
         }
         MPI_Barrier(mpiHeatTransferComm);
 
         double timeEnd = MPI_Wtime();
         if (rank == 0)
             std::cout << "Total runtime = " << timeEnd - timeStart << "s\n";
+        perf.printSummary(mpiHeatTransferComm);
     }
     catch (std::invalid_argument &e) // command-line argument errors
     {